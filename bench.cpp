@@ -0,0 +1,577 @@
+//By Monica Moniot
+//Times every step kernel over a matrix of grid sizes and starting patterns.
+//Each case is stepped in samples of several generations; the median and p99 of the
+//per-sample ns per cell are reported, and can be written as json and compared against
+//a json from an earlier run with --baseline.
+//With --check GENS nothing is timed: every kernel, and hashlife, is stepped GENS generations
+//from each case and its hash_simulation_cells has to match the one step_cells gets, and the
+//rule, jit and hensel engines are checked on the rules and edges in BENCH_RULES as well.
+#include <stdio.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include "SDL.h"
+#include "basic.h"
+#include "math.h"
+#include "assert.h"
+#include "random.hh"
+#include "grid.h"
+#include "bitgrid.h"
+#include "simd.h"
+#include "workers.h"
+#include "hashlife.h"
+#include "tiles.h"
+#include "blockgrid.h"
+#include "temporal.h"
+#include "inplace.h"
+#include "lut.h"
+#include "colsum.h"
+#include "rules.h"
+#include "jit.h"
+#include "hensel.h"
+#include "simulation.h"
+#include "patterns.h"
+#undef main
+
+#define BENCH_SAMPLE_CELLS (1<<22)//cells stepped per sample, so small grids still take a measurable time
+#define BENCH_MIN_SAMPLES 5
+#define BENCH_MAX_SIZES 16
+#define BENCH_MAX_RESULTS 1024
+#define BENCH_HASHLIFE_MEMORY (256*MEGABYTE)
+
+struct BenchKernel {
+	const char* name;
+	Engine engine;
+	SimdLevel level;//only for ENGINE_SIMD
+};
+const BenchKernel BENCH_KERNELS[] = {
+	{"byte", ENGINE_BYTE, SIMD_SCALAR},
+	{"scalar", ENGINE_SIMD, SIMD_SCALAR},
+	{"swar", ENGINE_SIMD, SIMD_SWAR},
+	{"sse2", ENGINE_SIMD, SIMD_SSE2},
+	{"avx2", ENGINE_SIMD, SIMD_AVX2},
+	{"avx512bw", ENGINE_SIMD, SIMD_AVX512BW},
+	{"bitpack", ENGINE_BITPACK, SIMD_SCALAR},
+	{"tiles", ENGINE_TILES, SIMD_SCALAR},
+	{"blocks", ENGINE_BLOCKS, SIMD_SCALAR},
+	{"morton", ENGINE_MORTON, SIMD_SCALAR},
+	{"temporal", ENGINE_TEMPORAL, SIMD_SCALAR},
+	{"inplace", ENGINE_INPLACE, SIMD_SCALAR},
+	{"lut", ENGINE_LUT, SIMD_SCALAR},
+	{"colsum", ENGINE_COLSUM, SIMD_SCALAR},
+	{"rule", ENGINE_RULE, SIMD_SCALAR},
+	{"jit", ENGINE_JIT, SIMD_SCALAR},
+	{"hensel", ENGINE_HENSEL, SIMD_SCALAR},
+};
+const uint32 BENCH_KERNELS_TOTAL = sizeof(BENCH_KERNELS)/sizeof(BENCH_KERNELS[0]);
+
+//what --check runs the engines that take a rule on, besides B3/S23 on a torus
+struct BenchRule {
+	const char* kernel;
+	const char* rule;
+	Boundary boundary;//only ENGINE_RULE runs anything but a torus
+};
+const BenchRule BENCH_RULES[] = {
+	{"rule", "B36/S23", BOUNDARY_TORUS},
+	{"rule", "B36/S23", BOUNDARY_DEAD},
+	{"rule", "B3678/S34678", BOUNDARY_KLEIN},
+	{"rule", "B2/S", BOUNDARY_DEAD},
+	{"rule", "B1357/S1357", BOUNDARY_KLEIN},
+	{"rule", "B3/S23", BOUNDARY_DEAD},
+	{"rule", "B3/S23", BOUNDARY_KLEIN},
+	{"jit", "B36/S23", BOUNDARY_TORUS},
+	{"jit", "B3678/S34678", BOUNDARY_TORUS},
+	{"jit", "B0/S8", BOUNDARY_TORUS},
+	{"jit", "B1357/S1357", BOUNDARY_TORUS},
+	{"jit", "B0123478/S01234678", BOUNDARY_TORUS},
+	{"hensel", "B2n3/S23-q", BOUNDARY_TORUS},
+	{"hensel", "B36/S23", BOUNDARY_TORUS},
+	{"hensel", "B0/S8", BOUNDARY_TORUS},
+	{"hensel", "B2-a/S12", BOUNDARY_TORUS},
+	{"hensel", "B3-cnqy/S234ceikqy", BOUNDARY_TORUS},
+	{"hensel", "B2ce3aeiy4ak/S12-k3acky4ajkty", BOUNDARY_TORUS},
+};
+const uint32 BENCH_RULES_TOTAL = sizeof(BENCH_RULES)/sizeof(BENCH_RULES[0]);
+
+struct BenchResult {
+	char kernel[32];
+	char pattern[32];
+	Dim cells;
+	uint32 samples;
+	uint32 gens_per_sample;
+	double median_ns_per_cell;
+	double p99_ns_per_cell;
+};
+
+struct BenchConfig {
+	uint32 sizes[BENCH_MAX_SIZES];
+	uint32 sizes_total;
+	const char* kernel_filter;
+	const char* pattern_filter;
+	uint32 max_samples;
+	float budget_ms;
+	uint32 threads_total;
+	const char* json_path;
+	const char* baseline_path;
+	float tolerance;
+	uint32 check_gens;//0 times the kernels, anything else checks them
+};
+
+int compare_doubles(const void* a, const void* b) {
+	double x = *cast(const double*, a);
+	double y = *cast(const double*, b);
+	return (x > y) - (x < y);
+}
+//nearest rank on an already sorted array
+inline double get_percentile(const double* sorted, uint32 total, double percent) {
+	uint32 rank = cast(uint32, ceil(percent*total/100.0));
+	rank = max(rank, 1u);
+	return sorted[min(rank, total) - 1];
+}
+
+BenchResult run_bench_case(const BenchConfig* config, const BenchKernel* kernel, const Pattern* pattern, Dim cells, byte* memory, WorkerPool* workers, double* samples) {
+	step_cells_rows = get_step_cells_rows(kernel->level);
+	Simulation sim;
+	byte* sim_memory = memory;
+	init_simulation(&sim, &sim_memory, cells, kernel->engine, workers);
+	PCG rng;
+	pcg_seed(&rng, 12);
+	place_pattern(sim.cells0, cells, pattern, &rng);
+	mark_simulation_edited(&sim);
+
+	uint64 cells_size = cast(uint64, cells.width)*cells.height;
+	uint32 gens_per_sample = cast(uint32, max(BENCH_SAMPLE_CELLS/cells_size, 1ull));
+	//one untimed sample, so the bit grid is packed and the caches are warm
+	for(uint32 i = 0; i < gens_per_sample;) i += step_simulation_gens(&sim, gens_per_sample - i);
+
+	uint64 frequency = SDL_GetPerformanceFrequency();
+	uint64 case_start = SDL_GetPerformanceCounter();
+	uint32 samples_total = 0;
+	while(samples_total < config->max_samples) {
+		uint64 t0 = SDL_GetPerformanceCounter();
+		for(uint32 i = 0; i < gens_per_sample;) i += step_simulation_gens(&sim, gens_per_sample - i);
+		uint64 t1 = SDL_GetPerformanceCounter();
+		samples[samples_total] = (1e9*(t1 - t0)/frequency)/(cast(double, gens_per_sample)*cells_size);
+		samples_total += 1;
+		float case_ms = (1000.0f*(t1 - case_start))/frequency;
+		if(samples_total >= BENCH_MIN_SAMPLES and case_ms > config->budget_ms) break;
+	}
+	qsort(samples, samples_total, sizeof(double), compare_doubles);
+
+	BenchResult result = {};
+	snprintf(result.kernel, sizeof(result.kernel), "%s", kernel->name);
+	snprintf(result.pattern, sizeof(result.pattern), "%s", pattern->name);
+	result.cells = cells;
+	result.samples = samples_total;
+	result.gens_per_sample = gens_per_sample;
+	result.median_ns_per_cell = get_percentile(samples, samples_total, 50);
+	result.p99_ns_per_cell = get_percentile(samples, samples_total, 99);
+	return result;
+}
+
+//steps the case gens generations on the kernel and hashes what comes out
+uint64 hash_bench_case(const BenchKernel* kernel, const Pattern* pattern, Dim cells, uint32 gens, byte* memory, WorkerPool* workers) {
+	step_cells_rows = get_step_cells_rows(kernel->level);
+	Simulation sim;
+	byte* sim_memory = memory;
+	init_simulation(&sim, &sim_memory, cells, kernel->engine, workers);
+	PCG rng;
+	pcg_seed(&rng, 12);
+	place_pattern(sim.cells0, cells, pattern, &rng);
+	mark_simulation_edited(&sim);
+	for(uint32 i = 0; i < gens;) i += step_simulation_gens(&sim, gens - i);
+	return hash_simulation_cells(&sim);
+}
+
+void write_bench_json(FILE* file, const BenchResult* results, uint32 results_total, uint32 threads_total) {
+	fprintf(file, "{\n");
+	fprintf(file, "  \"simd\": \"%s\",\n", SIMD_LEVEL_NAMES[simd_level]);
+	fprintf(file, "  \"threads\": %u,\n", threads_total);
+	fprintf(file, "  \"results\": [\n");
+	//one result per line, read_bench_json depends on it
+	for_each_lt(i, results_total) {
+		const BenchResult* r = &results[i];
+		fprintf(file, "    {\"kernel\": \"%s\", \"width\": %u, \"height\": %u, \"pattern\": \"%s\", \"samples\": %u, \"gens_per_sample\": %u, \"median_ns_per_cell\": %.6f, \"p99_ns_per_cell\": %.6f}%s\n",
+			r->kernel, r->cells.width, r->cells.height, r->pattern, r->samples, r->gens_per_sample, r->median_ns_per_cell, r->p99_ns_per_cell, (i + 1 < results_total) ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+}
+//reads back a file from write_bench_json, returns the number of results or -1
+int32 read_bench_json(const char* path, BenchResult* results, uint32 results_capacity) {
+	FILE* file = fopen(path, "r");
+	if(!file) return -1;
+	char line[512];
+	uint32 results_total = 0;
+	while(results_total < results_capacity and fgets(line, sizeof(line), file)) {
+		BenchResult r = {};
+		int matched = sscanf(line, " {\"kernel\": \"%31[^\"]\", \"width\": %u, \"height\": %u, \"pattern\": \"%31[^\"]\", \"samples\": %u, \"gens_per_sample\": %u, \"median_ns_per_cell\": %lf, \"p99_ns_per_cell\": %lf",
+			r.kernel, &r.cells.width, &r.cells.height, r.pattern, &r.samples, &r.gens_per_sample, &r.median_ns_per_cell, &r.p99_ns_per_cell);
+		if(matched == 8) {
+			results[results_total] = r;
+			results_total += 1;
+		}
+	}
+	fclose(file);
+	return results_total;
+}
+
+//prints the change of every result that is also in the baseline, returns how many got slower than the tolerance
+uint32 compare_bench_results(const BenchResult* results, uint32 results_total, const BenchResult* baseline, uint32 baseline_total, float tolerance) {
+	uint32 regressions_total = 0;
+	printf("\n%-10s %-11s %-12s %10s %10s %8s\n", "kernel", "size", "pattern", "baseline", "median", "change");
+	for_each_lt(i, results_total) {
+		const BenchResult* r = &results[i];
+		for(uint32 j = 0; j < baseline_total; j += 1) {
+			const BenchResult* b = &baseline[j];
+			if(strcmp(r->kernel, b->kernel) != 0 or strcmp(r->pattern, b->pattern) != 0) continue;
+			if(r->cells.width != b->cells.width or r->cells.height != b->cells.height) continue;
+			double change = r->median_ns_per_cell/b->median_ns_per_cell - 1;
+			bool is_regression = change > tolerance;
+			regressions_total += is_regression;
+			char size[32];
+			snprintf(size, sizeof(size), "%ux%u", r->cells.width, r->cells.height);
+			printf("%-10s %-11s %-12s %10.4f %10.4f %+7.1f%%%s\n", r->kernel, size, r->pattern, b->median_ns_per_cell, r->median_ns_per_cell, 100*change, is_regression ? " REGRESSION" : "");
+			break;
+		}
+	}
+	return regressions_total;
+}
+
+inline bool is_kernel_supported(const BenchKernel* kernel) {
+	return kernel->engine != ENGINE_SIMD or kernel->level <= simd_level;
+}
+//a comma separated filter, null matches everything
+inline bool is_in_filter(const char* filter, const char* name) {
+	if(!filter) return 1;
+	uint32 name_size = strlen(name);
+	const char* c = filter;
+	while(true) {
+		const char* end = strchr(c, ',');
+		uint32 size = end ? cast(uint32, end - c) : strlen(c);
+		if(size == name_size and strncmp(c, name, size) == 0) return 1;
+		if(!end) return 0;
+		c = end + 1;
+	}
+}
+
+//sets the rule and edge the kernel's engine steps, 0 if it has no such rule
+bool set_bench_rule(Engine engine, const char* rule, Boundary boundary) {
+	if(engine == ENGINE_RULE) return select_rule_kernel(rule, boundary);
+	if(engine == ENGINE_JIT) return set_jit_rule(rule);
+	if(engine == ENGINE_HENSEL) return set_hensel_rule(rule);
+	return parse_rule(rule) == CONWAY_RULE and boundary == BOUNDARY_TORUS;
+}
+inline const BenchKernel* find_bench_kernel(const char* name) {
+	for(uint32 i = 0; i < BENCH_KERNELS_TOTAL; i += 1) {
+		if(strcmp(BENCH_KERNELS[i].name, name) == 0) return &BENCH_KERNELS[i];
+	}
+	return 0;
+}
+//step_cells with the rule given as a table of every 3x3 neighbourhood, bit 3*row + col as in
+//hensel.h, and the cells past the edge read through get_boundary_cell
+template<Boundary boundary>
+void step_cells_reference(const bool* cells0, bool* cells1, Dim cells_dim, const uint8* table) {
+	for(int32 y = 0; y < cast(int32, cells_dim.height); y += 1) {
+		for(int32 x = 0; x < cast(int32, cells_dim.width); x += 1) {
+			uint32 neighbourhood = 0;
+			for(int32 dy = -1; dy <= 1; dy += 1) {
+				for(int32 dx = -1; dx <= 1; dx += 1) {
+					neighbourhood |= get_boundary_cell<boundary>(cells0, cells_dim, x + dx, y + dy)<<(3*(dy + 1) + dx + 1);
+				}
+			}
+			cells1[cast(uint64, cells_dim.width)*y + x] = table[neighbourhood];
+		}
+	}
+}
+//the hash the case has to come out at on the rule; 0 if the rule does not parse
+bool hash_reference_case(const BenchRule* bench_rule, const Pattern* pattern, Dim cells, uint32 gens, byte* memory, WorkerPool* workers, uint64* hash) {
+	//outer totalistic rules are turned into the table right here, only the others go through
+	//the hensel parser, which is checked on its own
+	uint8 table[HENSEL_NEIGHBOURHOODS];
+	uint32 bits = parse_rule(bench_rule->rule);
+	if(!(bits&RULE_INVALID)) {
+		for(uint32 i = 0; i < HENSEL_NEIGHBOURHOODS; i += 1) {
+			uint32 is_alive = (i>>HENSEL_MIDDLE_BIT)&1;
+			table[i] = (bits>>(popcount64(i&HENSEL_NEIGHBOURS_MASK) + 9*is_alive))&1;
+		}
+	} else if(set_hensel_rule(bench_rule->rule)) {
+		memcpy(table, hensel_table, sizeof(table));
+	} else {
+		return 0;
+	}
+	Simulation sim;
+	byte* sim_memory = memory;
+	init_simulation(&sim, &sim_memory, cells, ENGINE_BYTE, workers);
+	PCG rng;
+	pcg_seed(&rng, 12);
+	place_pattern(sim.cells0, cells, pattern, &rng);
+	for(uint32 i = 0; i < gens; i += 1) {
+		if(bench_rule->boundary == BOUNDARY_DEAD) {
+			step_cells_reference<BOUNDARY_DEAD>(sim.cells0, sim.cells1, cells, table);
+		} else if(bench_rule->boundary == BOUNDARY_KLEIN) {
+			step_cells_reference<BOUNDARY_KLEIN>(sim.cells0, sim.cells1, cells, table);
+		} else {
+			step_cells_reference<BOUNDARY_TORUS>(sim.cells0, sim.cells1, cells, table);
+		}
+		swap(&sim.cells0, &sim.cells1);
+	}
+	mark_simulation_edited(&sim);
+	*hash = hash_simulation_cells(&sim);
+	return 1;
+}
+
+//hashlife runs on the plane, not the torus, so the case is put in the middle of a grid with
+//gens + 1 dead cells around it: nothing gets far enough in gens generations to wrap, and
+//step_cells on that grid has to agree with the plane. Returns 0 if the grid does not fit in memory.
+bool hash_hashlife_case(HashLife* life, const Pattern* pattern, Dim cells, uint32 gens, WorkerPool* workers, uint64* hash, uint64* reference_hash) {
+	uint32 margin = gens + 1;
+	Dim padded = {cells.width + 2*margin, cells.height + 2*margin};
+	byte* memory = malloc(byte, get_simulation_memory_size(padded, ENGINE_BYTE));
+	if(!memory) return 0;
+	Simulation sim;
+	byte* sim_memory = memory;
+	init_simulation(&sim, &sim_memory, padded, ENGINE_BYTE, workers);
+	//placed the same as hash_bench_case would, in the other buffer, then copied into the middle
+	PCG rng;
+	pcg_seed(&rng, 12);
+	place_pattern(sim.cells1, cells, pattern, &rng);
+	for(uint32 y = 0; y < cells.height; y += 1) {
+		memcpy(&sim.cells0[cast(uint64, padded.width)*(y + margin) + margin], &sim.cells1[cast(uint64, cells.width)*y], cells.width);
+	}
+	mark_simulation_edited(&sim);
+
+	Vector origin = {0, 0};
+	load_hashlife_cells(life, sim.cells0, padded, origin);
+	for(int32 k = HASHLIFE_MAX_STEP_LOG2; k >= 0; k -= 1) {
+		if((cast(uint64, gens)>>k)&1) step_hashlife(life, k);
+	}
+	for(uint32 i = 0; i < gens;) i += step_simulation_gens(&sim, gens - i);
+	*reference_hash = hash_simulation_cells(&sim);
+	read_hashlife_cells(life, sim.cells0, padded, origin);
+	mark_simulation_edited(&sim);
+	*hash = hash_simulation_cells(&sim);
+	free(memory);
+	return 1;
+}
+//prints a line per case and returns how many came out different from step_cells
+uint32 check_bench_cases(const BenchConfig* config, byte* memory, WorkerPool* workers) {
+	const BenchKernel reference = {"byte", ENGINE_BYTE, SIMD_SCALAR};
+	HashLife life;
+	init_hashlife(&life, BENCH_HASHLIFE_MEMORY);
+	uint32 mismatches_total = 0;
+	printf("%-10s %-11s %-12s %16s %16s\n", "kernel", "size", "pattern", "step_cells hash", "hash");
+	for(uint32 size_i = 0; size_i < config->sizes_total; size_i += 1) {
+		Dim cells = {config->sizes[size_i], config->sizes[size_i]};
+		char size[32];
+		snprintf(size, sizeof(size), "%ux%u", cells.width, cells.height);
+		for(uint32 pattern_i = 0; pattern_i < PATTERNS_TOTAL; pattern_i += 1) {
+			const Pattern* pattern = &PATTERNS[pattern_i];
+			if(!is_in_filter(config->pattern_filter, pattern->name)) continue;
+			uint64 reference_hash = hash_bench_case(&reference, pattern, cells, config->check_gens, memory, workers);
+			for(uint32 kernel_i = 0; kernel_i < BENCH_KERNELS_TOTAL; kernel_i += 1) {
+				const BenchKernel* kernel = &BENCH_KERNELS[kernel_i];
+				if(!is_kernel_supported(kernel) or !is_in_filter(config->kernel_filter, kernel->name)) continue;
+				uint64 hash = hash_bench_case(kernel, pattern, cells, config->check_gens, memory, workers);
+				mismatches_total += (hash != reference_hash);
+				printf("%-10s %-11s %-12s %016llx %016llx%s\n", kernel->name, size, pattern->name, cast(unsigned long long, reference_hash), cast(unsigned long long, hash), (hash != reference_hash) ? " MISMATCH" : "");
+				fflush(stdout);
+			}
+			if(is_in_filter(config->kernel_filter, "hashlife")) {
+				uint64 hash;
+				uint64 padded_hash;
+				if(!hash_hashlife_case(&life, pattern, cells, config->check_gens, workers, &hash, &padded_hash)) {
+					printf("Could not allocate the padded grid for hashlife at %s.\n", size);
+					mismatches_total += 1;
+					continue;
+				}
+				mismatches_total += (hash != padded_hash);
+				printf("%-10s %-11s %-12s %016llx %016llx%s\n", "hashlife", size, pattern->name, cast(unsigned long long, padded_hash), cast(unsigned long long, hash), (hash != padded_hash) ? " MISMATCH" : "");
+				fflush(stdout);
+			}
+			for(uint32 rule_i = 0; rule_i < BENCH_RULES_TOTAL; rule_i += 1) {
+				const BenchRule* bench_rule = &BENCH_RULES[rule_i];
+				const BenchKernel* kernel = find_bench_kernel(bench_rule->kernel);
+				if(!kernel or !is_in_filter(config->kernel_filter, kernel->name)) continue;
+				uint64 rule_reference_hash;
+				if(!hash_reference_case(bench_rule, pattern, cells, config->check_gens, memory, workers, &rule_reference_hash) or !set_bench_rule(kernel->engine, bench_rule->rule, bench_rule->boundary)) {
+					printf("%-10s %-11s %-12s cannot run %s with a %s boundary\n", kernel->name, size, pattern->name, bench_rule->rule, BOUNDARY_NAMES[bench_rule->boundary]);
+					mismatches_total += 1;
+					continue;
+				}
+				uint64 hash = hash_bench_case(kernel, pattern, cells, config->check_gens, memory, workers);
+				mismatches_total += (hash != rule_reference_hash);
+				printf("%-10s %-11s %-12s %016llx %016llx %s %s%s\n", kernel->name, size, pattern->name, cast(unsigned long long, rule_reference_hash), cast(unsigned long long, hash), bench_rule->rule, BOUNDARY_NAMES[bench_rule->boundary], (hash != rule_reference_hash) ? " MISMATCH" : "");
+				fflush(stdout);
+				//the next pattern runs every kernel on B3/S23 again
+				set_bench_rule(kernel->engine, "B3/S23", BOUNDARY_TORUS);
+			}
+		}
+	}
+	destroy_hashlife(&life);
+	return mismatches_total;
+}
+
+void print_bench_usage() {
+	printf("usage: bench [--sizes N,N,...] [--kernels NAME,...] [--patterns NAME,...] [--samples N]\n");
+	printf("             [--budget-ms MS] [--threads N] [--json PATH] [--baseline PATH] [--tolerance F]\n");
+	printf("             [--check GENS]\n");
+	printf("--threads 0 uses one thread per core, --check GENS checks the kernels instead of timing them\n");
+}
+
+int main(int argc, char** argv) {
+	BenchConfig config = {};
+	//from a few L1 sized rows up to grids far bigger than any last level cache
+	uint32 default_sizes[] = {64, 256, 1024, 4096, 8192};
+	for_each_lt(i, sizeof(default_sizes)/sizeof(default_sizes[0])) {
+		config.sizes[i] = default_sizes[i];
+		config.sizes_total += 1;
+	}
+	config.max_samples = 31;
+	config.budget_ms = 1000;
+	config.threads_total = 1;
+	config.tolerance = .1f;
+	for(int i = 1; i < argc; i += 1) {
+		if(strcmp(argv[i], "--sizes") == 0 and i + 1 < argc) {
+			i += 1;
+			config.sizes_total = 0;
+			for(char* c = argv[i]; *c and config.sizes_total < BENCH_MAX_SIZES;) {
+				uint32 size = strtoul(c, &c, 10);
+				if(size > 3) {
+					config.sizes[config.sizes_total] = size;
+					config.sizes_total += 1;
+				}
+				if(*c == ',') c += 1;
+				else break;
+			}
+		} else if(strcmp(argv[i], "--kernels") == 0 and i + 1 < argc) {
+			i += 1;
+			config.kernel_filter = argv[i];
+		} else if(strcmp(argv[i], "--patterns") == 0 and i + 1 < argc) {
+			i += 1;
+			config.pattern_filter = argv[i];
+		} else if(strcmp(argv[i], "--samples") == 0 and i + 1 < argc) {
+			i += 1;
+			config.max_samples = max(cast(uint32, atoi(argv[i])), cast(uint32, BENCH_MIN_SAMPLES));
+		} else if(strcmp(argv[i], "--budget-ms") == 0 and i + 1 < argc) {
+			i += 1;
+			config.budget_ms = atof(argv[i]);
+		} else if(strcmp(argv[i], "--threads") == 0 and i + 1 < argc) {
+			i += 1;
+			config.threads_total = atoi(argv[i]);
+		} else if(strcmp(argv[i], "--json") == 0 and i + 1 < argc) {
+			i += 1;
+			config.json_path = argv[i];
+		} else if(strcmp(argv[i], "--baseline") == 0 and i + 1 < argc) {
+			i += 1;
+			config.baseline_path = argv[i];
+		} else if(strcmp(argv[i], "--tolerance") == 0 and i + 1 < argc) {
+			i += 1;
+			config.tolerance = atof(argv[i]);
+		} else if(strcmp(argv[i], "--check") == 0 and i + 1 < argc) {
+			i += 1;
+			config.check_gens = atoi(argv[i]);
+		} else {
+			printf("unknown argument: %s\n", argv[i]);
+			print_bench_usage();
+			return 1;
+		}
+	}
+
+	init_simd_kernels();
+	if(config.threads_total == 0) {
+		config.threads_total = SDL_GetCPUCount();
+	}
+	WorkerPool workers;
+	init_worker_pool(&workers, config.threads_total);
+	printf("host supports %s, stepping with %u threads\n", SIMD_LEVEL_NAMES[simd_level], workers.threads_total);
+
+	Dim max_cells = {0, 0};
+	for(uint32 i = 0; i < config.sizes_total; i += 1) {
+		max_cells.width = max(max_cells.width, config.sizes[i]);
+	}
+	max_cells.height = max_cells.width;
+	uint64 memory_size = 0;
+	for(uint32 kernel_i = 0; kernel_i < BENCH_KERNELS_TOTAL; kernel_i += 1) {
+		memory_size = max(memory_size, get_simulation_memory_size(max_cells, BENCH_KERNELS[kernel_i].engine));
+	}
+	byte* memory = malloc(byte, memory_size);
+	double* samples = malloc(double, config.max_samples);
+	BenchResult* results = malloc(BenchResult, BENCH_MAX_RESULTS);
+	uint32 results_total = 0;
+	if(!memory or !samples or !results) {
+		printf("Could not allocate a %ux%u grid.\n", max_cells.width, max_cells.height);
+		return -1;
+	}
+
+	if(config.check_gens) {
+		uint32 mismatches_total = check_bench_cases(&config, memory, &workers);
+		printf("%u cases differ from step_cells after %u generations\n", mismatches_total, config.check_gens);
+		free(results);
+		free(samples);
+		free(memory);
+		destroy_worker_pool(&workers);
+		return mismatches_total > 0;
+	}
+
+	printf("%-10s %-11s %-12s %8s %12s %12s\n", "kernel", "size", "pattern", "samples", "median ns", "p99 ns");
+	for(uint32 kernel_i = 0; kernel_i < BENCH_KERNELS_TOTAL; kernel_i += 1) {
+		const BenchKernel* kernel = &BENCH_KERNELS[kernel_i];
+		if(!is_kernel_supported(kernel) or !is_in_filter(config.kernel_filter, kernel->name)) continue;
+		for(uint32 size_i = 0; size_i < config.sizes_total; size_i += 1) {
+			Dim cells = {config.sizes[size_i], config.sizes[size_i]};
+			for(uint32 pattern_i = 0; pattern_i < PATTERNS_TOTAL; pattern_i += 1) {
+				const Pattern* pattern = &PATTERNS[pattern_i];
+				if(!is_in_filter(config.pattern_filter, pattern->name) or results_total >= BENCH_MAX_RESULTS) continue;
+				BenchResult r = run_bench_case(&config, kernel, pattern, cells, memory, &workers, samples);
+				results[results_total] = r;
+				results_total += 1;
+				char size[32];
+				snprintf(size, sizeof(size), "%ux%u", cells.width, cells.height);
+				printf("%-10s %-11s %-12s %8u %12.4f %12.4f\n", r.kernel, size, r.pattern, r.samples, r.median_ns_per_cell, r.p99_ns_per_cell);
+				fflush(stdout);
+			}
+		}
+	}
+
+	int ret = 0;
+	if(config.json_path) {
+		FILE* file = (strcmp(config.json_path, "-") == 0) ? stdout : fopen(config.json_path, "w");
+		if(file) {
+			write_bench_json(file, results, results_total, workers.threads_total);
+			if(file != stdout) fclose(file);
+		} else {
+			printf("Could not write %s.\n", config.json_path);
+			ret = -1;
+		}
+	}
+	if(config.baseline_path) {
+		BenchResult* baseline = malloc(BenchResult, BENCH_MAX_RESULTS);
+		int32 baseline_total = read_bench_json(config.baseline_path, baseline, BENCH_MAX_RESULTS);
+		if(baseline_total < 0) {
+			printf("Could not read baseline %s.\n", config.baseline_path);
+			ret = -1;
+		} else {
+			uint32 regressions_total = compare_bench_results(results, results_total, baseline, baseline_total, config.tolerance);
+			printf("%u of %u cases slower than the baseline by more than %.0f%%\n", regressions_total, results_total, 100*config.tolerance);
+			if(regressions_total > 0) ret = 1;
+		}
+		free(baseline);
+	}
+
+	free(results);
+	free(samples);
+	free(memory);
+	destroy_worker_pool(&workers);
+	return ret;
+}
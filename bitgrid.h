@@ -0,0 +1,127 @@
+//By Monica Moniot
+#pragma once
+//Bit-packed grid: 64 cells per uint64, bit i of word w in a row is cell x = 64*w + i.
+//Rows are padded out to whole words and the padding bits are always kept at zero.
+//Nothing in here touches SDL, so it can be driven from update_game or headless.
+
+inline uint32 get_bit_words_per_row(uint32 cells_width) {
+	return divceil(cells_width, 64);
+}
+inline uint64 get_bit_words_size(Dim cells) {
+	return cast(uint64, get_bit_words_per_row(cells.width))*cells.height;
+}
+inline uint64 get_last_word_mask(uint32 cells_width) {
+	uint32 used = cells_width%64;
+	return used ? ((cast(uint64, 1)<<used) - 1) : ~cast(uint64, 0);
+}
+
+inline void set_bit(uint64* bits, uint32 words_per_row, int32 x, int32 y, bool state) {
+	uint64* word = &bits[words_per_row*y + x/64];
+	uint64 bit = cast(uint64, 1)<<(x%64);
+	*word = state ? (*word | bit) : (*word & ~bit);
+}
+
+void pack_cells(uint64* bits, const bool* cells, Dim cells_dim) {
+	uint32 words_per_row = get_bit_words_per_row(cells_dim.width);
+	for_each_lt(y, cells_dim.height) {
+		const bool* row = &cells[cells_dim.width*y];
+		uint64* bit_row = &bits[words_per_row*y];
+		for(uint32 w = 0; w < words_per_row; w += 1) {
+			uint32 x0 = 64*w;
+			uint32 x1 = min(x0 + 64, cells_dim.width);
+			uint64 word = 0;
+			for(uint32 x = x0; x < x1; x += 1) {
+				word |= cast(uint64, row[x])<<(x - x0);
+			}
+			bit_row[w] = word;
+		}
+	}
+}
+void unpack_bits(bool* cells, const uint64* bits, Dim cells_dim) {
+	uint32 words_per_row = get_bit_words_per_row(cells_dim.width);
+	for_each_lt(y, cells_dim.height) {
+		bool* row = &cells[cells_dim.width*y];
+		const uint64* bit_row = &bits[words_per_row*y];
+		for(uint32 w = 0; w < words_per_row; w += 1) {
+			uint32 x0 = 64*w;
+			uint32 x1 = min(x0 + 64, cells_dim.width);
+			uint64 word = bit_row[w];
+			for(uint32 x = x0; x < x1; x += 1) {
+				row[x] = (word>>(x - x0))&1;
+			}
+		}
+	}
+}
+
+inline uint32 popcount64(uint64 v) {
+	//SWAR popcount so we don't depend on a compiler intrinsic being available
+	v = v - ((v>>1)&0x5555555555555555ull);
+	v = (v&0x3333333333333333ull) + ((v>>2)&0x3333333333333333ull);
+	v = (v + (v>>4))&0x0F0F0F0F0F0F0F0Full;
+	return cast(uint32, (v*0x0101010101010101ull)>>56);
+}
+uint64 count_bits_population(const uint64* bits, Dim cells_dim) {
+	uint64 total = 0;
+	for_each_in(word, bits, get_bit_words_size(cells_dim)) {
+		total += popcount64(*word);
+	}
+	return total;
+}
+
+//the eight neighbours of every bit in a word, summed with a network of full and half adders;
+//returns the B3/S23 result for all 64 cells at once
+inline uint64 step_bit_word(uint64 up_w, uint64 up, uint64 up_e, uint64 cur_w, uint64 cur, uint64 cur_e, uint64 down_w, uint64 down, uint64 down_e) {
+	uint64 up_ones   = up_w^up^up_e;
+	uint64 up_twos   = (up_w&up)|(up_e&(up_w^up));
+	uint64 cur_ones  = cur_w^cur_e;
+	uint64 cur_twos  = cur_w&cur_e;
+	uint64 down_ones = down_w^down^down_e;
+	uint64 down_twos = (down_w&down)|(down_e&(down_w^down));
+
+	uint64 ones  = up_ones^cur_ones^down_ones;
+	uint64 carry = (up_ones&cur_ones)|(down_ones&(up_ones^cur_ones));
+	//the count is 2*(twos total) + ones, we need the twos total to be exactly 1
+	uint64 twos_parity = up_twos^cur_twos^down_twos^carry;
+	uint64 twos_pairs = (up_twos&cur_twos)|(down_twos&carry);
+	uint64 is_two_or_three = twos_parity&~twos_pairs;
+	return is_two_or_three&(ones|cur);
+}
+
+//the row shifted so that each bit lines up with its west (x - 1) or east (x + 1) neighbour,
+//wrapping around the torus through the first and last words of the row
+inline uint64 get_west_word(const uint64* row, uint32 w, uint32 last_word, uint32 cells_width) {
+	uint64 carry_in = (w == 0) ? (row[last_word]>>((cells_width - 1)%64)) : (row[w - 1]>>63);
+	return (row[w]<<1)|(carry_in&1);
+}
+inline uint64 get_east_word(const uint64* row, uint32 w, uint32 last_word, uint32 cells_width) {
+	if(w == last_word) {
+		return (row[w]>>1)|((row[0]&1)<<((cells_width - 1)%64));
+	}
+	return (row[w]>>1)|(row[w + 1]<<63);
+}
+
+//computes rows [row_begin, row_end) of the next generation, wrapping around as a torus
+void step_bits_rows(const uint64* bits0, uint64* bits1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	uint32 words_per_row = get_bit_words_per_row(cells_dim.width);
+	uint32 last_word = words_per_row - 1;
+	uint64 last_mask = get_last_word_mask(cells_dim.width);
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		uint32 up_y = (y == 0) ? cells_dim.height - 1 : y - 1;
+		uint32 down_y = (y + 1 == cells_dim.height) ? 0 : y + 1;
+		const uint64* up_row = &bits0[words_per_row*up_y];
+		const uint64* cur_row = &bits0[words_per_row*y];
+		const uint64* down_row = &bits0[words_per_row*down_y];
+		uint64* new_row = &bits1[words_per_row*y];
+		for(uint32 w = 0; w < words_per_row; w += 1) {
+			new_row[w] = step_bit_word(
+				get_west_word(up_row, w, last_word, cells_dim.width), up_row[w], get_east_word(up_row, w, last_word, cells_dim.width),
+				get_west_word(cur_row, w, last_word, cells_dim.width), cur_row[w], get_east_word(cur_row, w, last_word, cells_dim.width),
+				get_west_word(down_row, w, last_word, cells_dim.width), down_row[w], get_east_word(down_row, w, last_word, cells_dim.width)
+			);
+		}
+		new_row[last_word] &= last_mask;
+	}
+}
+inline void step_bits(const uint64* bits0, uint64* bits1, Dim cells_dim) {
+	step_bits_rows(bits0, bits1, cells_dim, 0, cells_dim.height);
+}
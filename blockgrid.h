@@ -0,0 +1,227 @@
+//By Monica Moniot
+#pragma once
+//Blocked grid: the cells cut into BLOCK_SIZE x BLOCK_SIZE blocks, each stored on its own
+//with a one cell halo ring around it, so a block is one contiguous BLOCK_STRIDE^2 buffer.
+//A generation fills each block's halo from its neighbours and then steps the block only
+//from its own buffer, a few KB that stay in L1 however wide the grid is. The blocks are
+//stored either row by row or in Z (Morton) order, which keeps blocks that are close on the
+//grid close in memory too. Blocks on the right and bottom edges can be partly unused.
+
+#define BLOCK_SIZE 64
+#define BLOCK_STRIDE (BLOCK_SIZE + 2)//a row with its west and east halo cells
+#define BLOCK_CELLS (BLOCK_STRIDE*BLOCK_STRIDE)
+
+struct BlockGrid {
+	Dim cells;
+	Dim blocks;
+	bool is_morton;
+	uint32* slots;//block_y*blocks.width + block_x -> where the block is stored
+	Vector* coords;//where a block is stored -> block_x, block_y
+};
+
+inline Dim get_blocks_dim(Dim cells) {
+	Dim blocks = {divceil(cells.width, BLOCK_SIZE), divceil(cells.height, BLOCK_SIZE)};
+	return blocks;
+}
+inline uint32 get_blocks_size(Dim cells) {
+	Dim blocks = get_blocks_dim(cells);
+	return blocks.width*blocks.height;
+}
+//the cells of both generations and the tables of a BlockGrid
+inline uint64 get_block_grid_memory_size(Dim cells) {
+	uint64 blocks_size = get_blocks_size(cells);
+	return 2*blocks_size*BLOCK_CELLS + blocks_size*(sizeof(uint32) + sizeof(Vector));
+}
+
+//spreads the low 16 bits of v out to the even bits
+inline uint32 spread_bits(uint32 v) {
+	v &= 0xFFFF;
+	v = (v|(v<<8))&0x00FF00FF;
+	v = (v|(v<<4))&0x0F0F0F0F;
+	v = (v|(v<<2))&0x33333333;
+	v = (v|(v<<1))&0x55555555;
+	return v;
+}
+inline uint32 get_morton_code(uint32 x, uint32 y) {
+	return spread_bits(x)|(spread_bits(y)<<1);
+}
+inline uint32 compact_bits(uint32 v) {
+	v &= 0x55555555;
+	v = (v|(v>>1))&0x33333333;
+	v = (v|(v>>2))&0x0F0F0F0F;
+	v = (v|(v>>4))&0x00FF00FF;
+	v = (v|(v>>8))&0x0000FFFF;
+	return v;
+}
+
+void init_block_grid(BlockGrid* grid, byte** memory, Dim cells, bool is_morton) {
+	memzero(grid, sizeof(BlockGrid));
+	grid->cells = cells;
+	grid->blocks = get_blocks_dim(cells);
+	grid->is_morton = is_morton;
+	uint32 blocks_size = grid->blocks.width*grid->blocks.height;
+	grid->slots = claim_bytes(uint32, memory, blocks_size);
+	grid->coords = claim_bytes(Vector, memory, blocks_size);
+	if(is_morton) {
+		//walks the Z curve of the smallest power of two square around the blocks and
+		//packs the blocks that exist, in the order it meets them
+		uint32 side = 1;
+		while(side < grid->blocks.width or side < grid->blocks.height) side *= 2;
+		uint32 slot = 0;
+		for(uint64 code = 0; code < cast(uint64, side)*side; code += 1) {
+			uint32 block_x = compact_bits(cast(uint32, code));
+			uint32 block_y = compact_bits(cast(uint32, code>>1));
+			if(block_x >= grid->blocks.width or block_y >= grid->blocks.height) continue;
+			grid->slots[grid->blocks.width*block_y + block_x] = slot;
+			grid->coords[slot].x = block_x;
+			grid->coords[slot].y = block_y;
+			slot += 1;
+		}
+	} else {
+		for_each_lt(i, blocks_size) {
+			grid->slots[i] = i;
+			grid->coords[i].x = i%grid->blocks.width;
+			grid->coords[i].y = i/grid->blocks.width;
+		}
+	}
+}
+
+inline uint64 get_block_offset(const BlockGrid* grid, uint32 block_x, uint32 block_y) {
+	return cast(uint64, BLOCK_CELLS)*grid->slots[grid->blocks.width*block_y + block_x];
+}
+//where cell x, y of the grid sits inside its block's buffer, halo included
+inline uint64 get_block_cell_offset(const BlockGrid* grid, uint32 x, uint32 y) {
+	return get_block_offset(grid, x/BLOCK_SIZE, y/BLOCK_SIZE) + BLOCK_STRIDE*(y%BLOCK_SIZE + 1) + x%BLOCK_SIZE + 1;
+}
+
+inline void set_block_cell(const BlockGrid* grid, uint8* blocks, Vector pos, bool state) {
+	blocks[get_block_cell_offset(grid, pos.x, pos.y)] = state;
+}
+
+void pack_blocks(const BlockGrid* grid, uint8* blocks, const bool* cells) {
+	Dim cells_dim = grid->cells;
+	for_each_lt(block_y, grid->blocks.height) {
+		uint32 y0 = block_y*BLOCK_SIZE;
+		uint32 h = min(cast(uint32, BLOCK_SIZE), cells_dim.height - y0);
+		for(uint32 block_x = 0; block_x < grid->blocks.width; block_x += 1) {
+			uint32 x0 = block_x*BLOCK_SIZE;
+			uint32 w = min(cast(uint32, BLOCK_SIZE), cells_dim.width - x0);
+			uint8* block = &blocks[get_block_offset(grid, block_x, block_y)];
+			for(uint32 y = 0; y < h; y += 1) {
+				memcpy(block + BLOCK_STRIDE*(y + 1) + 1, &cells[cast(uint64, cells_dim.width)*(y0 + y) + x0], w);
+			}
+		}
+	}
+}
+void unpack_blocks(const BlockGrid* grid, bool* cells, const uint8* blocks) {
+	Dim cells_dim = grid->cells;
+	for_each_lt(block_y, grid->blocks.height) {
+		uint32 y0 = block_y*BLOCK_SIZE;
+		uint32 h = min(cast(uint32, BLOCK_SIZE), cells_dim.height - y0);
+		for(uint32 block_x = 0; block_x < grid->blocks.width; block_x += 1) {
+			uint32 x0 = block_x*BLOCK_SIZE;
+			uint32 w = min(cast(uint32, BLOCK_SIZE), cells_dim.width - x0);
+			const uint8* block = &blocks[get_block_offset(grid, block_x, block_y)];
+			for(uint32 y = 0; y < h; y += 1) {
+				memcpy(&cells[cast(uint64, cells_dim.width)*(y0 + y) + x0], block + BLOCK_STRIDE*(y + 1) + 1, w);
+			}
+		}
+	}
+}
+
+//copies the cells around a block into its halo ring, wrapping around the torus; only the
+//insides of the other blocks are read, so blocks can be filled from several threads at once
+void fill_block_halo(const BlockGrid* grid, uint8* blocks, uint32 block_x, uint32 block_y) {
+	Dim cells = grid->cells;
+	uint32 x0 = block_x*BLOCK_SIZE;
+	uint32 y0 = block_y*BLOCK_SIZE;
+	uint32 w = min(cast(uint32, BLOCK_SIZE), cells.width - x0);
+	uint32 h = min(cast(uint32, BLOCK_SIZE), cells.height - y0);
+	uint32 west_x = (x0 == 0) ? cells.width - 1 : x0 - 1;
+	uint32 east_x = (x0 + w == cells.width) ? 0 : x0 + w;
+	uint32 north_y = (y0 == 0) ? cells.height - 1 : y0 - 1;
+	uint32 south_y = (y0 + h == cells.height) ? 0 : y0 + h;
+	uint8* block = &blocks[get_block_offset(grid, block_x, block_y)];
+	//the blocks above and below have the same columns, so their rows copy straight across
+	memcpy(block + 1, &blocks[get_block_cell_offset(grid, x0, north_y)], w);
+	memcpy(block + BLOCK_STRIDE*(h + 1) + 1, &blocks[get_block_cell_offset(grid, x0, south_y)], w);
+	//and the blocks beside it have the same rows, only the corners come from somewhere else
+	const uint8* west = &blocks[get_block_cell_offset(grid, west_x, y0)] - BLOCK_STRIDE;
+	const uint8* east = &blocks[get_block_cell_offset(grid, east_x, y0)] - BLOCK_STRIDE;
+	for(uint32 y = 1; y <= h; y += 1) {
+		block[BLOCK_STRIDE*y] = west[BLOCK_STRIDE*y];
+		block[BLOCK_STRIDE*y + w + 1] = east[BLOCK_STRIDE*y];
+	}
+	block[0] = blocks[get_block_cell_offset(grid, west_x, north_y)];
+	block[w + 1] = blocks[get_block_cell_offset(grid, east_x, north_y)];
+	block[BLOCK_STRIDE*(h + 1)] = blocks[get_block_cell_offset(grid, west_x, south_y)];
+	block[BLOCK_STRIDE*(h + 1) + w + 1] = blocks[get_block_cell_offset(grid, east_x, south_y)];
+}
+//steps the w x h cells of a block whose halo is filled, reading nothing outside its buffer
+void step_block_scalar(const uint8* block0, uint8* block1, uint32 w, uint32 h) {
+	for(uint32 y = 1; y <= h; y += 1) {
+		const uint8* up = block0 + BLOCK_STRIDE*(y - 1);
+		const uint8* cur = block0 + BLOCK_STRIDE*y;
+		const uint8* down = block0 + BLOCK_STRIDE*(y + 1);
+		uint8* new_row = block1 + BLOCK_STRIDE*y;
+		for(uint32 x = 1; x <= w; x += 1) {
+			new_row[x] = step_cell_byte(up, cur, down, x - 1, x, x + 1);
+		}
+	}
+}
+#if LIFE_X86
+//with the halo in place no row wraps, so every row is plain vectors; a narrower edge block is
+//stepped to the vector past w, the cells past w come out as garbage but are never read back as cells
+TARGET_SSE2 void step_block_sse2(const uint8* block0, uint8* block1, uint32 w, uint32 h) {
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i three = _mm_set1_epi8(3);
+	for(uint32 y = 1; y <= h; y += 1) {
+		const uint8* up = block0 + BLOCK_STRIDE*(y - 1);
+		const uint8* cur = block0 + BLOCK_STRIDE*y;
+		const uint8* down = block0 + BLOCK_STRIDE*(y + 1);
+		uint8* new_row = block1 + BLOCK_STRIDE*y;
+		for(uint32 x = 1; x <= w; x += 16) {
+			__m128i total = _mm_add_epi8(_mm_loadu_si128(cast(const __m128i*, up + x - 1)), _mm_loadu_si128(cast(const __m128i*, up + x)));
+			total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, up + x + 1)));
+			total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, cur + x - 1)));
+			total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, cur + x + 1)));
+			total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, down + x - 1)));
+			total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, down + x)));
+			total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, down + x + 1)));
+			__m128i alive = _mm_cmpeq_epi8(_mm_or_si128(total, _mm_loadu_si128(cast(const __m128i*, cur + x))), three);
+			_mm_storeu_si128(cast(__m128i*, new_row + x), _mm_and_si128(alive, one));
+		}
+	}
+}
+#endif
+inline void step_block(const uint8* block0, uint8* block1, uint32 w, uint32 h) {
+#if LIFE_X86
+	if(simd_level >= SIMD_SSE2) {
+		step_block_sse2(block0, block1, w, h);
+		return;
+	}
+#endif
+	step_block_scalar(block0, block1, w, h);
+}
+
+struct StepBlocksJob {
+	const BlockGrid* grid;
+	uint8* blocks0;
+	uint8* blocks1;
+};
+//the stripes are ranges of storage slots, so with Z order each thread gets a compact patch of blocks
+void step_blocks_stripe(void* data, uint32 slot_begin, uint32 slot_end) {
+	StepBlocksJob* job = cast(StepBlocksJob*, data);
+	const BlockGrid* grid = job->grid;
+	for(uint32 slot = slot_begin; slot < slot_end; slot += 1) {
+		Vector block = grid->coords[slot];
+		uint32 w = min(cast(uint32, BLOCK_SIZE), grid->cells.width - block.x*BLOCK_SIZE);
+		uint32 h = min(cast(uint32, BLOCK_SIZE), grid->cells.height - block.y*BLOCK_SIZE);
+		fill_block_halo(grid, job->blocks0, block.x, block.y);
+		step_block(&job->blocks0[cast(uint64, BLOCK_CELLS)*slot], &job->blocks1[cast(uint64, BLOCK_CELLS)*slot], w, h);
+	}
+}
+void step_blocks_striped(WorkerPool* pool, const BlockGrid* grid, uint8* blocks0, uint8* blocks1) {
+	StepBlocksJob job = {grid, blocks0, blocks1};
+	run_stripes(pool, step_blocks_stripe, &job, grid->blocks.width*grid->blocks.height);
+}
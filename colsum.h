@@ -0,0 +1,41 @@
+//By Monica Moniot
+#pragma once
+//Separable stepping for the byte grid: the up + cur + down sum of a column is shared by the
+//three cells across it, so each row first sums its columns into a buffer once and then every
+//cell's count is three neighbouring sums less the cell itself. Both loops are straight runs
+//over bytes with no wrap in them, for the compiler to vectorize on whatever it targets.
+
+//columns stepped at a time; the loops run a constant count, which is what lets them vectorize
+//with no scalar epilogue even at the cheapest cost model
+#define COLSUM_CHUNK 64
+
+void step_cells_row_colsum(CellRows r, uint32 cells_width) {
+	//sums[i] is the column sum of x - 1 + i, the middle cells are copied out next to them so
+	//the second loop only reads the stack and nothing has to prove new_row is not one of the rows
+	uint8 sums[COLSUM_CHUNK + 2];
+	uint8 centers[COLSUM_CHUNK];
+	r.new_row[0] = step_cell_byte(r.up, r.cur, r.down, cells_width - 1, 0, 1);
+	uint32 x = 1;
+	for(; x + COLSUM_CHUNK <= cells_width - 1; x += COLSUM_CHUNK) {
+		const uint8* up = r.up + x - 1;
+		const uint8* cur = r.cur + x - 1;
+		const uint8* down = r.down + x - 1;
+		for(uint32 i = 0; i < COLSUM_CHUNK; i += 1) {
+			sums[i] = up[i] + cur[i] + down[i];
+			centers[i] = cur[i + 1];
+		}
+		sums[COLSUM_CHUNK] = up[COLSUM_CHUNK] + cur[COLSUM_CHUNK] + down[COLSUM_CHUNK];
+		sums[COLSUM_CHUNK + 1] = up[COLSUM_CHUNK + 1] + cur[COLSUM_CHUNK + 1] + down[COLSUM_CHUNK + 1];
+		bool* new_row = r.new_row + x;
+		for(uint32 i = 0; i < COLSUM_CHUNK; i += 1) {
+			uint8 total = sums[i] + sums[i + 1] + sums[i + 2] - centers[i];
+			new_row[i] = (total|centers[i]) == 3;
+		}
+	}
+	step_cells_row_tail(r.up, r.cur, r.down, r.new_row, x, cells_width);
+}
+void step_cells_rows_colsum(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		step_cells_row_colsum(get_cell_rows(cells0, cells1, cells_dim, y), cells_dim.width);
+	}
+}
@@ -0,0 +1,29 @@
+//By Monica Moniot
+#pragma once
+
+struct Vector {
+	int32 x;
+	int32 y;
+};
+struct Dim {
+	uint32 width;
+	uint32 height;
+};
+
+
+inline bool get_cell(const bool* cells, uint32 cells_width, Vector pos) {
+	auto cell = &cells[cells_width*pos.y + pos.x];
+	return *cell;
+}
+inline void set_cell(bool* cells, uint32 cells_width, Vector pos, bool state) {
+	auto cell = &cells[cells_width*pos.y + pos.x];
+	*cell = (state);
+}
+inline bool get_cell(const bool* cells, uint32 cells_width, int32 x, int32 y) {
+	Vector v = {x, y};
+	return get_cell(cells, cells_width, v);
+}
+inline void set_cell(bool* cells, uint32 cells_width, int32 x, int32 y, bool state) {
+	Vector v = {x, y};
+	set_cell(cells, cells_width, v, state);
+}
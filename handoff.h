@@ -0,0 +1,83 @@
+//By Monica Moniot
+#pragma once
+//Lock-free triple buffer that hands finished generations from the simulation thread to the
+//main thread. The writer fills its own frame and swaps it with the ready one; the reader swaps
+//its own frame with the ready one when it is fresh. Neither side ever waits on the other, and
+//each frame is only touched by whoever holds its index, so only the ready index is shared.
+//Tile versions say what changed: a tile whose version is newer than the version the reader
+//last drew has to be redrawn, and everything does when redraw_version is newer.
+
+#define FRAME_FRESH 4//set in the ready index until the reader takes it
+
+struct SimFrame {
+	Dim cells;
+	bool* cells0;
+	uint64* tile_versions;
+	uint32 cells_capacity;
+	uint32 tiles_capacity;
+	uint64 version;
+	uint64 redraw_version;
+	uint64 generation;
+	TileStats tile_stats;
+	bool is_running;
+};
+struct FrameHandoff {
+	SimFrame frames[3];
+	SDL_atomic_t ready;
+	uint32 write_index;//only used by the writer
+	uint32 read_index;//only used by the reader
+};
+
+void init_frame_handoff(FrameHandoff* handoff) {
+	memzero(handoff, sizeof(FrameHandoff));
+	handoff->write_index = 0;
+	SDL_AtomicSet(&handoff->ready, 1);
+	handoff->read_index = 2;
+}
+void destroy_frame_handoff(FrameHandoff* handoff) {
+	for_each_lt(i, 3) {
+		free(handoff->frames[i].cells0);
+		free(handoff->frames[i].tile_versions);
+	}
+	memzero(handoff, sizeof(FrameHandoff));
+}
+
+//the frame only the writer may touch, grown to fit a grid of the given size; its cells are
+//still those of its version, unless that was reset to 0
+SimFrame* get_write_frame(FrameHandoff* handoff, Dim cells) {
+	SimFrame* frame = &handoff->frames[handoff->write_index];
+	uint32 cells_size = cells.width*cells.height;
+	if(frame->cells_capacity < cells_size) {
+		free(frame->cells0);
+		frame->cells0 = malloc(bool, cells_size);
+		frame->cells_capacity = cells_size;
+	}
+	//what the frame holds is worth nothing at a different size
+	if(frame->cells.width != cells.width or frame->cells.height != cells.height) frame->version = 0;
+	uint32 tiles_size = get_tiles_size(cells);
+	if(frame->tiles_capacity < tiles_size) {
+		free(frame->tile_versions);
+		frame->tile_versions = malloc(uint64, tiles_size);
+		frame->tiles_capacity = tiles_size;
+	}
+	frame->cells = cells;
+	return frame;
+}
+//whether the reader has taken the last frame that was published
+inline bool is_frame_taken(FrameHandoff* handoff) {
+	return !(SDL_AtomicGet(&handoff->ready)&FRAME_FRESH);
+}
+inline void publish_frame(FrameHandoff* handoff) {
+	SDL_MemoryBarrierRelease();
+	int ready = SDL_AtomicSet(&handoff->ready, handoff->write_index|FRAME_FRESH);
+	handoff->write_index = ready&~FRAME_FRESH;
+}
+//the latest published frame, or null when nothing was published since the last call;
+//the frame stays valid until the next call that returns a frame
+SimFrame* take_frame(FrameHandoff* handoff) {
+	if(!(SDL_AtomicGet(&handoff->ready)&FRAME_FRESH)) return 0;
+	int ready = SDL_AtomicSet(&handoff->ready, handoff->read_index);
+	handoff->read_index = ready&~FRAME_FRESH;
+	SDL_MemoryBarrierAcquire();
+	return &handoff->frames[handoff->read_index];
+}
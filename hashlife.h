@@ -0,0 +1,381 @@
+//By Monica Moniot
+#pragma once
+//HashLife: the universe is a canonical quadtree where equal squares share one node, and every
+//node memoizes its RESULT, the centre half of the square advanced 2^min(step_log2, level - 2)
+//generations. Runs on the infinite plane, not the torus that update_game steps.
+//The root is kept centered on the origin, so a level n root covers [-2^(n-1), 2^(n-1)).
+//Nodes come out of malloc'd blocks; once the live ones take more than memory_budget the tree
+//is garbage collected down to what the root and the step in progress still use, which also
+//drops every memoized result.
+
+struct HashNode {
+	HashNode* nw;
+	HashNode* ne;
+	HashNode* sw;
+	HashNode* se;
+	HashNode* result;
+	HashNode* next;//hash chain
+	uint64 population;
+	uint32 level;
+	uint32 is_marked;
+};
+#define HASHNODE_FREE_LEVEL (~cast(uint32, 0))
+#define HASHNODE_BLOCK_SIZE 16384
+#define HASHLIFE_MAX_LEVEL 60
+#define HASHLIFE_MAX_STEP_LOG2 (HASHLIFE_MAX_LEVEL - 4)
+//every node advance_hash_node is in the middle of, and the ones it has made for it so far
+#define HASHLIFE_STACK_SIZE (16*HASHLIFE_MAX_LEVEL)
+struct HashNodeBlock {
+	HashNodeBlock* next;
+	uint32 used;
+	HashNode nodes[HASHNODE_BLOCK_SIZE];
+};
+struct HashLife {
+	HashNode** table;
+	uint64 table_size;
+	uint64 nodes_total;
+	HashNodeBlock* blocks;
+	uint64 blocks_total;
+	HashNode* free_nodes;
+	HashNode* empty[HASHLIFE_MAX_LEVEL + 1];
+	HashNode cells[2];//the dead and live level 0 leaves
+	HashNode* root;
+	uint64 generation;
+	int32 step_log2;//the step every memoized result was computed for
+	uint64 memory_budget;
+	uint64 collect_at;//memory used past which the next collection runs
+	uint32 collections_total;
+	HashNode* stack[HASHLIFE_STACK_SIZE];
+	uint32 stack_total;
+};
+
+//only the live nodes, the free ones are reused before any new block is allocated
+inline uint64 get_hashlife_memory_used(const HashLife* life) {
+	return life->nodes_total*sizeof(HashNode) + life->table_size*sizeof(HashNode*);
+}
+
+inline uint64 hash_children(const HashNode* nw, const HashNode* ne, const HashNode* sw, const HashNode* se) {
+	uint64 h = cast(uint64, nw);
+	h = h*0x9E3779B97F4A7C15ull + cast(uint64, ne);
+	h = h*0x9E3779B97F4A7C15ull + cast(uint64, sw);
+	h = h*0x9E3779B97F4A7C15ull + cast(uint64, se);
+	return h^(h>>29);
+}
+
+void resize_hash_table(HashLife* life, uint64 new_size) {
+	HashNode** new_table = malloc(HashNode*, new_size);
+	memzero(new_table, sizeof(HashNode*)*new_size);
+	for_each_lt(i, life->table_size) {
+		HashNode* node = life->table[i];
+		while(node) {
+			HashNode* next = node->next;
+			uint64 h = hash_children(node->nw, node->ne, node->sw, node->se)&(new_size - 1);
+			node->next = new_table[h];
+			new_table[h] = node;
+			node = next;
+		}
+	}
+	free(life->table);
+	life->table = new_table;
+	life->table_size = new_size;
+}
+
+HashNode* alloc_hash_node(HashLife* life) {
+	if(life->free_nodes) {
+		HashNode* node = life->free_nodes;
+		life->free_nodes = node->next;
+		return node;
+	}
+	HashNodeBlock* block = life->blocks;
+	if(!block or block->used == HASHNODE_BLOCK_SIZE) {
+		block = malloc(HashNodeBlock, 1);
+		block->next = life->blocks;
+		block->used = 0;
+		life->blocks = block;
+		life->blocks_total += 1;
+	}
+	HashNode* node = &block->nodes[block->used];
+	block->used += 1;
+	return node;
+}
+
+HashNode* get_hash_node(HashLife* life, HashNode* nw, HashNode* ne, HashNode* sw, HashNode* se) {
+	uint64 h = hash_children(nw, ne, sw, se)&(life->table_size - 1);
+	for(HashNode* node = life->table[h]; node; node = node->next) {
+		if(node->nw == nw and node->ne == ne and node->sw == sw and node->se == se) {
+			return node;
+		}
+	}
+	HashNode* node = alloc_hash_node(life);
+	node->nw = nw;
+	node->ne = ne;
+	node->sw = sw;
+	node->se = se;
+	node->result = 0;
+	node->population = nw->population + ne->population + sw->population + se->population;
+	node->level = nw->level + 1;
+	node->is_marked = 0;
+	node->next = life->table[h];
+	life->table[h] = node;
+	life->nodes_total += 1;
+	if(life->nodes_total > life->table_size) {
+		resize_hash_table(life, 2*life->table_size);
+	}
+	return node;
+}
+
+HashNode* get_empty_node(HashLife* life, uint32 level) {
+	if(!life->empty[level]) {
+		HashNode* e = get_empty_node(life, level - 1);
+		life->empty[level] = get_hash_node(life, e, e, e, e);
+	}
+	return life->empty[level];
+}
+
+void init_hashlife(HashLife* life, uint64 memory_budget) {
+	memzero(life, sizeof(HashLife));
+	life->memory_budget = memory_budget;
+	life->collect_at = memory_budget;
+	life->table_size = 1<<16;
+	life->table = malloc(HashNode*, life->table_size);
+	memzero(life->table, sizeof(HashNode*)*life->table_size);
+	life->cells[1].population = 1;
+	life->empty[0] = &life->cells[0];
+	life->step_log2 = -1;
+	life->root = get_empty_node(life, 3);
+}
+void destroy_hashlife(HashLife* life) {
+	while(life->blocks) {
+		HashNodeBlock* next = life->blocks->next;
+		free(life->blocks);
+		life->blocks = next;
+	}
+	free(life->table);
+	memzero(life, sizeof(HashLife));
+}
+
+//calls fn on every node that is allocated and not on the free list
+#define for_each_hash_node(name, life) for(HashNodeBlock* __block = (life)->blocks; __block; __block = __block->next) for(HashNode* name = __block->nodes; name != __block->nodes + __block->used; name += 1) if(name->level != HASHNODE_FREE_LEVEL)
+
+//a node whose result is 2^(level - 2) generations on has the same result under every step
+//at least that long, so only the nodes above min_level have to be cleared
+void clear_hashlife_results(HashLife* life, uint32 min_level) {
+	for_each_hash_node(node, life) {
+		if(node->level > min_level) node->result = 0;
+	}
+}
+
+void mark_hash_node(HashNode* node) {
+	if(node->level == 0 or node->is_marked) return;
+	node->is_marked = 1;
+	mark_hash_node(node->nw);
+	mark_hash_node(node->ne);
+	mark_hash_node(node->sw);
+	mark_hash_node(node->se);
+}
+//keeps only the nodes the root, the stack and the empty cache reach, every memoized result is dropped
+void collect_hashlife(HashLife* life) {
+	for_each_hash_node(node, life) {
+		node->is_marked = 0;
+	}
+	mark_hash_node(life->root);
+	for(uint32 i = 0; i < life->stack_total; i += 1) {
+		mark_hash_node(life->stack[i]);
+	}
+	for_each_lt(level, HASHLIFE_MAX_LEVEL + 1) {
+		if(life->empty[level]) mark_hash_node(life->empty[level]);
+	}
+	memzero(life->table, sizeof(HashNode*)*life->table_size);
+	life->nodes_total = 0;
+	for_each_hash_node(node, life) {
+		if(node->is_marked) {
+			uint64 h = hash_children(node->nw, node->ne, node->sw, node->se)&(life->table_size - 1);
+			node->result = 0;
+			node->next = life->table[h];
+			life->table[h] = node;
+			life->nodes_total += 1;
+		} else {
+			node->level = HASHNODE_FREE_LEVEL;
+			node->next = life->free_nodes;
+			life->free_nodes = node;
+		}
+	}
+	life->collections_total += 1;
+	//when what is live is most of the budget, collecting again right away would free next to nothing
+	life->collect_at = max(life->memory_budget, 2*get_hashlife_memory_used(life));
+}
+
+inline void push_hash_node(HashLife* life, HashNode* node) {
+	assert(life->stack_total < HASHLIFE_STACK_SIZE);
+	life->stack[life->stack_total] = node;
+	life->stack_total += 1;
+}
+
+
+inline HashNode* get_centre_node(HashLife* life, HashNode* node) {
+	return get_hash_node(life, node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+inline HashNode* get_horizontal_centre_node(HashLife* life, HashNode* w, HashNode* e) {
+	return get_hash_node(life, w->ne, e->nw, w->se, e->sw);
+}
+inline HashNode* get_vertical_centre_node(HashLife* life, HashNode* n, HashNode* s) {
+	return get_hash_node(life, n->sw, n->se, s->nw, s->ne);
+}
+
+//one generation of the 4x4 square in a level 2 node, giving its centre 2x2
+HashNode* step_hash_leaf(HashLife* life, HashNode* node) {
+	uint32 grid = 0;//bit 4*y + x
+	HashNode* quads[4] = {node->nw, node->ne, node->sw, node->se};
+	for_each_lt(q, 4) {
+		uint32 x0 = 2*(q%2);
+		uint32 y0 = 2*(q/2);
+		HashNode* quad = quads[q];
+		grid |= cast(uint32, quad->nw->population)<<(4*y0 + x0);
+		grid |= cast(uint32, quad->ne->population)<<(4*y0 + x0 + 1);
+		grid |= cast(uint32, quad->sw->population)<<(4*(y0 + 1) + x0);
+		grid |= cast(uint32, quad->se->population)<<(4*(y0 + 1) + x0 + 1);
+	}
+	HashNode* new_cells[4];
+	for(uint32 i = 0; i < 4; i += 1) {
+		uint32 x = 1 + i%2;
+		uint32 y = 1 + i/2;
+		uint32 total_adj_cell = 0;
+		for(uint32 ny = y - 1; ny <= y + 1; ny += 1) {
+			for(uint32 nx = x - 1; nx <= x + 1; nx += 1) {
+				if(nx != x or ny != y) total_adj_cell += (grid>>(4*ny + nx))&1;
+			}
+		}
+		bool cur = (grid>>(4*y + x))&1;
+		new_cells[i] = &life->cells[(total_adj_cell == 3) or (cur and total_adj_cell == 2)];
+	}
+	return get_hash_node(life, new_cells[0], new_cells[1], new_cells[2], new_cells[3]);
+}
+
+//the only place the tree is collected, every node the steps in progress still need is on the
+//stack by then; the nodes made between two calls are a handful per level, so the budget can
+//only be overshot by that much
+HashNode* advance_hash_node(HashLife* life, HashNode* node) {
+	if(node->result) return node->result;
+	uint32 stack_begin = life->stack_total;
+	push_hash_node(life, node);
+	if(get_hashlife_memory_used(life) > life->collect_at) {
+		collect_hashlife(life);
+	}
+	HashNode* result;
+	if(node->population == 0) {
+		result = get_empty_node(life, node->level - 1);
+	} else if(node->level == 2) {
+		result = step_hash_leaf(life, node);
+	} else {
+		HashNode* n00 = node->nw;
+		HashNode* n01 = get_horizontal_centre_node(life, node->nw, node->ne);
+		HashNode* n02 = node->ne;
+		HashNode* n10 = get_vertical_centre_node(life, node->nw, node->sw);
+		HashNode* n11 = get_centre_node(life, node);
+		HashNode* n12 = get_vertical_centre_node(life, node->ne, node->se);
+		HashNode* n20 = node->sw;
+		HashNode* n21 = get_horizontal_centre_node(life, node->sw, node->se);
+		HashNode* n22 = node->se;
+		HashNode* r[9] = {n00, n01, n02, n10, n11, n12, n20, n21, n22};
+		//each of r is kept on the stack in its own slot, and swapped for its result once it has one
+		HashNode** slots = &life->stack[life->stack_total];
+		for(uint32 i = 0; i < 9; i += 1) {
+			push_hash_node(life, r[i]);
+		}
+		//a full step spends 2^(level - 3) generations on each of the two halves,
+		//a partial one only spends them on the second half and just recentres the first
+		bool is_full_step = life->step_log2 >= cast(int32, node->level) - 2;
+		for(uint32 i = 0; i < 9; i += 1) {
+			r[i] = is_full_step ? advance_hash_node(life, r[i]) : get_centre_node(life, r[i]);
+			slots[i] = r[i];
+		}
+		uint32 quads[4][4] = {{0, 1, 3, 4}, {1, 2, 4, 5}, {3, 4, 6, 7}, {4, 5, 7, 8}};
+		HashNode* q[4];
+		for(uint32 i = 0; i < 4; i += 1) {
+			q[i] = advance_hash_node(life, get_hash_node(life, r[quads[i][0]], r[quads[i][1]], r[quads[i][2]], r[quads[i][3]]));
+			push_hash_node(life, q[i]);
+		}
+		result = get_hash_node(life, q[0], q[1], q[2], q[3]);
+	}
+	life->stack_total = stack_begin;
+	node->result = result;
+	return result;
+}
+
+//a level n + 1 node with the same centre
+HashNode* expand_hash_node(HashLife* life, HashNode* node) {
+	HashNode* e = get_empty_node(life, node->level - 1);
+	return get_hash_node(life,
+		get_hash_node(life, e, e, e, node->nw),
+		get_hash_node(life, e, e, node->ne, e),
+		get_hash_node(life, e, node->sw, e, e),
+		get_hash_node(life, node->se, e, e, e)
+	);
+}
+
+//advances the universe 2^step_log2 generations
+void step_hashlife(HashLife* life, uint32 step_log2) {
+	assert(step_log2 <= HASHLIFE_MAX_STEP_LOG2);
+	if(life->step_log2 != cast(int32, step_log2)) {
+		clear_hashlife_results(life, cast(uint32, min(life->step_log2, cast(int32, step_log2)) + 2));
+		life->step_log2 = step_log2;
+	}
+	//the pattern has to sit in the centre quarter of the root, so it can't outrun the result
+	HashNode* root = life->root;
+	while(root->level < step_log2 + 3 or root->population != get_centre_node(life, get_centre_node(life, root))->population) {
+		assert(root->level < HASHLIFE_MAX_LEVEL);
+		root = expand_hash_node(life, root);
+	}
+	life->root = advance_hash_node(life, root);
+	life->generation += cast(uint64, 1)<<step_log2;
+}
+
+
+HashNode* build_hash_node(HashLife* life, const bool* cells, Dim cells_dim, int64 x0, int64 y0, uint32 level) {
+	//x0, y0 are relative to cells[0]
+	int64 size = cast(int64, 1)<<level;
+	if(x0 >= cells_dim.width or y0 >= cells_dim.height or x0 + size <= 0 or y0 + size <= 0) {
+		return get_empty_node(life, level);
+	}
+	if(level == 0) {
+		return &life->cells[cells[cells_dim.width*y0 + x0]];
+	}
+	int64 half = size/2;
+	return get_hash_node(life,
+		build_hash_node(life, cells, cells_dim, x0, y0, level - 1),
+		build_hash_node(life, cells, cells_dim, x0 + half, y0, level - 1),
+		build_hash_node(life, cells, cells_dim, x0, y0 + half, level - 1),
+		build_hash_node(life, cells, cells_dim, x0 + half, y0 + half, level - 1)
+	);
+}
+//replaces the universe with the given cells, cells[0] lands on the plane at origin
+void load_hashlife_cells(HashLife* life, const bool* cells, Dim cells_dim, Vector origin) {
+	int64 extent = max(max(-cast(int64, origin.x), cast(int64, origin.x) + cells_dim.width), max(-cast(int64, origin.y), cast(int64, origin.y) + cells_dim.height));
+	uint32 level = 3;
+	while((cast(int64, 1)<<(level - 1)) < extent) level += 1;
+	int64 half = cast(int64, 1)<<(level - 1);
+	life->root = build_hash_node(life, cells, cells_dim, -half - origin.x, -half - origin.y, level);
+	life->generation = 0;
+}
+
+void read_hash_node(const HashNode* node, bool* cells, Dim cells_dim, int64 x0, int64 y0) {
+	int64 size = cast(int64, 1)<<node->level;
+	if(node->population == 0 or x0 >= cells_dim.width or y0 >= cells_dim.height or x0 + size <= 0 or y0 + size <= 0) {
+		return;
+	}
+	if(node->level == 0) {
+		cells[cells_dim.width*y0 + x0] = 1;
+		return;
+	}
+	int64 half = size/2;
+	read_hash_node(node->nw, cells, cells_dim, x0, y0);
+	read_hash_node(node->ne, cells, cells_dim, x0 + half, y0);
+	read_hash_node(node->sw, cells, cells_dim, x0, y0 + half);
+	read_hash_node(node->se, cells, cells_dim, x0 + half, y0 + half);
+}
+//writes the viewport of the plane starting at origin into cells, ready for render_from_cells
+void read_hashlife_cells(const HashLife* life, bool* cells, Dim cells_dim, Vector origin) {
+	memzero(cells, cells_dim.width*cells_dim.height);
+	int64 half = cast(int64, 1)<<(life->root->level - 1);
+	read_hash_node(life->root, cells, cells_dim, -half - origin.x, -half - origin.y);
+}
@@ -0,0 +1,244 @@
+//By Monica Moniot
+#pragma once
+//Isotropic non-totalistic rules in Hensel notation, like B2n3/S23-q, for ENGINE_HENSEL on the
+//bit grid. A count can be narrowed down by letters that each stand for one shape of that many
+//neighbours up to rotation and reflection, "3-q" being every 3 but the q shape. The rule is
+//compiled into a table of all 512 3x3 neighbourhoods and the table into a decision diagram
+//over the nine cells, which is stepped bit-sliced: every node of it picks between two others
+//by one cell, so it runs over 64 cells of a word at once in three bit ops.
+
+//bit 3*row + col of a neighbourhood is the cell col - 1 across and row - 1 down from the middle
+#define HENSEL_NEIGHBOURHOODS 512
+#define HENSEL_MIDDLE_BIT 4
+#define HENSEL_NEIGHBOURS_MASK (0x1FF&~(1<<HENSEL_MIDDLE_BIT))
+
+//the letters of each count, in the order of HENSEL_SHAPES; 5 to 8 reuse those of 3 to 0
+const char* HENSEL_LETTERS[9] = {"", "ce", "ceaikn", "ceaiknjqry", "ceaiknjqrytwz", "ceaiknjqry", "ceaikn", "ce", ""};
+//one neighbourhood of each shape of 0 to 4 neighbours, the shapes of 8 - n are their complements
+const uint16 HENSEL_SHAPES[5][13] = {
+	{0},
+	{1, 2},
+	{5, 10, 3, 40, 33, 68},
+	{69, 42, 11, 7, 98, 13, 14, 70, 41, 97},
+	{325, 170, 15, 45, 99, 71, 106, 102, 43, 101, 105, 78, 108},
+};
+
+uint8 hensel_table[HENSEL_NEIGHBOURHOODS];
+bool is_hensel_rule_set = 0;
+
+//nodes 0 and 1 are the dead and alive leaves, every other node comes after the two it picks
+//between; a diagram over 9 cells can't have more than 511 nodes that pick
+#define HENSEL_DEAD_NODE 0
+#define HENSEL_ALIVE_NODE 1
+#define HENSEL_LEAVES 2
+#define HENSEL_NODES_MAX 511
+struct HenselNode {
+	uint8 cell;//the neighbourhood bit it picks by
+	uint16 lo;//the node for when that cell is dead
+	uint16 hi;//and for when it is alive
+};
+struct HenselDiagram {
+	HenselNode nodes[HENSEL_LEAVES + HENSEL_NODES_MAX];
+	uint32 nodes_total;
+	uint32 root;
+};
+HenselDiagram hensel_diagram;
+//the order the cells are picked in decides how big the diagram gets, the smallest one is kept;
+//edges before corners keeps Conway's at 26 nodes, rules that pick shapes apart do better with
+//the corners first or with the cells taken round the ring
+const uint8 HENSEL_ORDERS[][9] = {
+	{1, 3, 5, 7, 0, 2, 6, 8, 4},
+	{0, 2, 6, 8, 1, 3, 5, 7, 4},
+	{1, 3, 5, 7, 4, 0, 2, 6, 8},
+	{1, 2, 5, 8, 7, 6, 3, 0, 4},
+};
+const uint32 HENSEL_ORDERS_TOTAL = sizeof(HENSEL_ORDERS)/sizeof(HENSEL_ORDERS[0]);
+
+//the neighbourhood turned by one of the 8 symmetries of the square
+inline uint32 transform_neighbourhood(uint32 neighbourhood, uint32 symmetry) {
+	uint32 result = 0;
+	for(uint32 bit = 0; bit < 9; bit += 1) {
+		if(!((neighbourhood>>bit)&1)) continue;
+		uint32 row = bit/3;
+		uint32 col = bit%3;
+		if(symmetry&4) swap(&row, &col);
+		if(symmetry&1) row = 2 - row;
+		if(symmetry&2) col = 2 - col;
+		result |= 1<<(3*row + col);
+	}
+	return result;
+}
+inline uint32 get_hensel_shape(uint32 count, uint32 letter) {
+	if(count <= 4) return HENSEL_SHAPES[count][letter];
+	return HENSEL_SHAPES[8 - count][letter]^HENSEL_NEIGHBOURS_MASK;
+}
+//which letter of its count the neighbours are
+uint32 get_hensel_letter(uint32 neighbours, uint32 count) {
+	uint32 letters_total = max(cast(uint32, strlen(HENSEL_LETTERS[count])), 1u);
+	for(uint32 letter = 0; letter < letters_total; letter += 1) {
+		uint32 shape = get_hensel_shape(count, letter);
+		for(uint32 symmetry = 0; symmetry < 8; symmetry += 1) {
+			if(transform_neighbourhood(shape, symmetry) == neighbours) return letter;
+		}
+	}
+	assert(0);
+	return 0;
+}
+
+//bit l of letters[n] lets in the l-th shape of n neighbours
+struct HenselSection {
+	uint16 letters[9];
+};
+#define HENSEL_ALL_LETTERS "ceaiknjqrytwz"
+//reads one B or S section from *c on, up to a '/', the next section or the end
+bool parse_hensel_section(const char** c, HenselSection* section) {
+	memzero(section, sizeof(HenselSection));
+	while(**c and !strchr("/BbSs", **c)) {
+		if(**c < '0' or **c > '8') return 0;
+		uint32 count = **c - '0';
+		*c += 1;
+		const char* letters = HENSEL_LETTERS[count];
+		uint16 all = cast(uint16, (1<<max(cast(uint32, strlen(letters)), 1u)) - 1);
+		bool is_minus = (**c == '-');
+		if(is_minus) *c += 1;
+		uint16 picked = 0;
+		while(**c and strchr(HENSEL_ALL_LETTERS, **c)) {
+			const char* letter = strchr(letters, **c);
+			if(!letter) return 0;
+			picked |= 1<<(letter - letters);
+			*c += 1;
+		}
+		if(is_minus and !picked) return 0;
+		section->letters[count] |= is_minus ? (all&~picked) : (picked ? picked : all);
+	}
+	return 1;
+}
+//the subdiagram of every neighbourhood that agrees with fixed on the cells picked by so far
+uint32 build_hensel_node(HenselDiagram* diagram, const uint8* order, uint32 depth, uint32 fixed) {
+	if(depth == 9) return hensel_table[fixed] ? HENSEL_ALIVE_NODE : HENSEL_DEAD_NODE;
+	uint32 lo = build_hensel_node(diagram, order, depth + 1, fixed);
+	uint32 hi = build_hensel_node(diagram, order, depth + 1, fixed|(1<<order[depth]));
+	if(lo == hi) return lo;
+	for(uint32 i = HENSEL_LEAVES; i < diagram->nodes_total; i += 1) {
+		HenselNode node = diagram->nodes[i];
+		if(node.cell == order[depth] and node.lo == lo and node.hi == hi) return i;
+	}
+	assert(diagram->nodes_total < HENSEL_LEAVES + HENSEL_NODES_MAX);
+	diagram->nodes[diagram->nodes_total] = {order[depth], cast(uint16, lo), cast(uint16, hi)};
+	diagram->nodes_total += 1;
+	return diagram->nodes_total - 1;
+}
+void build_hensel_diagram() {
+	HenselDiagram diagram;
+	for(uint32 i = 0; i < HENSEL_ORDERS_TOTAL; i += 1) {
+		diagram.nodes_total = HENSEL_LEAVES;
+		diagram.root = build_hensel_node(&diagram, HENSEL_ORDERS[i], 0, 0);
+		if(i == 0 or diagram.nodes_total < hensel_diagram.nodes_total) hensel_diagram = diagram;
+	}
+}
+//0 if the rule does not parse, the table is left as it was
+bool set_hensel_rule(const char* rule) {
+	HenselSection births = {};
+	HenselSection survivals = {};
+	bool has_births = 0;
+	bool has_survivals = 0;
+	const char* c = rule;
+	while(*c) {
+		if(*c == 'B' or *c == 'b') {
+			c += 1;
+			if(has_births or !parse_hensel_section(&c, &births)) return 0;
+			has_births = 1;
+		} else if(*c == 'S' or *c == 's') {
+			c += 1;
+			if(has_survivals or !parse_hensel_section(&c, &survivals)) return 0;
+			has_survivals = 1;
+		} else if(*c == '/') {
+			c += 1;
+		} else {
+			return 0;
+		}
+	}
+	if(!has_births and !has_survivals) return 0;
+	for_each_lt(neighbourhood, cast(uint32, HENSEL_NEIGHBOURHOODS)) {
+		uint32 neighbours = neighbourhood&HENSEL_NEIGHBOURS_MASK;
+		uint32 count = popcount64(neighbours);
+		uint32 letter = get_hensel_letter(neighbours, count);
+		const HenselSection* section = ((neighbourhood>>HENSEL_MIDDLE_BIT)&1) ? &survivals : &births;
+		hensel_table[neighbourhood] = (section->letters[count]>>letter)&1;
+	}
+	build_hensel_diagram();
+	is_hensel_rule_set = 1;
+	return 1;
+}
+
+//words of a row run through each node at a time; the loops run a constant count so they vectorize
+#define HENSEL_CHUNK_WORDS 8
+
+//set_hensel_rule has to have been called
+void step_hensel_rows(const uint64* bits0, uint64* bits1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	//cells[3*row + col] are the words of the neighbourhood bit of that row and col, values[n] is node n
+	uint64 cells[9][HENSEL_CHUNK_WORDS];
+	uint64 values[HENSEL_LEAVES + HENSEL_NODES_MAX][HENSEL_CHUNK_WORDS];
+	const HenselDiagram* diagram = &hensel_diagram;
+	memzero(cells, sizeof(cells));
+	for(uint32 i = 0; i < HENSEL_CHUNK_WORDS; i += 1) {
+		values[HENSEL_DEAD_NODE][i] = 0;
+		values[HENSEL_ALIVE_NODE][i] = ~cast(uint64, 0);
+	}
+	uint32 words_per_row = get_bit_words_per_row(cells_dim.width);
+	uint32 last_word = words_per_row - 1;
+	uint64 last_mask = get_last_word_mask(cells_dim.width);
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		uint32 up_y = (y == 0) ? cells_dim.height - 1 : y - 1;
+		uint32 down_y = (y + 1 == cells_dim.height) ? 0 : y + 1;
+		const uint64* up_row = &bits0[cast(uint64, words_per_row)*up_y];
+		const uint64* cur_row = &bits0[cast(uint64, words_per_row)*y];
+		const uint64* down_row = &bits0[cast(uint64, words_per_row)*down_y];
+		uint64* new_row = &bits1[cast(uint64, words_per_row)*y];
+		for(uint32 w0 = 0; w0 < words_per_row; w0 += HENSEL_CHUNK_WORDS) {
+			uint32 words_total = min(words_per_row - w0, cast(uint32, HENSEL_CHUNK_WORDS));
+			//past the end of the row the words keep whatever was there, what comes out of them is dropped
+			for(uint32 i = 0; i < words_total; i += 1) {
+				uint32 w = w0 + i;
+				cells[0][i] = get_west_word(up_row, w, last_word, cells_dim.width);
+				cells[1][i] = up_row[w];
+				cells[2][i] = get_east_word(up_row, w, last_word, cells_dim.width);
+				cells[3][i] = get_west_word(cur_row, w, last_word, cells_dim.width);
+				cells[4][i] = cur_row[w];
+				cells[5][i] = get_east_word(cur_row, w, last_word, cells_dim.width);
+				cells[6][i] = get_west_word(down_row, w, last_word, cells_dim.width);
+				cells[7][i] = down_row[w];
+				cells[8][i] = get_east_word(down_row, w, last_word, cells_dim.width);
+			}
+			for(uint32 n = HENSEL_LEAVES; n < diagram->nodes_total; n += 1) {
+				HenselNode node = diagram->nodes[n];
+				const uint64* cell = cells[node.cell];
+				const uint64* lo = values[node.lo];
+				const uint64* hi = values[node.hi];
+				//worked out on the stack and copied in, so nothing has to prove values[n] is not lo or hi
+				uint64 value[HENSEL_CHUNK_WORDS];
+				for(uint32 i = 0; i < HENSEL_CHUNK_WORDS; i += 1) {
+					value[i] = lo[i]^(cell[i]&(lo[i]^hi[i]));
+				}
+				memcpy(values[n], value, sizeof(value));
+			}
+			memcpy(&new_row[w0], values[diagram->root], sizeof(uint64)*words_total);
+		}
+		new_row[last_word] &= last_mask;
+	}
+}
+
+struct StepHenselJob {
+	const uint64* bits0;
+	uint64* bits1;
+	Dim cells;
+};
+void step_hensel_stripe(void* data, uint32 row_begin, uint32 row_end) {
+	StepHenselJob* job = cast(StepHenselJob*, data);
+	step_hensel_rows(job->bits0, job->bits1, job->cells, row_begin, row_end);
+}
+//set_hensel_rule has to have been called
+void step_hensel_striped(WorkerPool* pool, const uint64* bits0, uint64* bits1, Dim cells) {
+	StepHenselJob job = {bits0, bits1, cells};
+	run_stripes(pool, step_hensel_stripe, &job, cells.height);
+}
@@ -0,0 +1,79 @@
+//By Monica Moniot
+#pragma once
+//In-place stepping for the byte grid, with no second grid to step into. Rows are stepped top
+//to bottom and a row is only overwritten once the one above it is done, so the row below is
+//still the old one when it is needed; all that is kept of the old generation is a copy of the
+//row being stepped and of the one above it. The grid is cut into INPLACE_STRIPES stripes that
+//step on their own, the first and last row of every stripe are saved before any of them
+//starts, since the stripes on either side need them as they were, and that also covers the
+//wrap from the last row to the first.
+//With no cells1, bit grid or tiles that about halves the memory of the Simulation, less the
+//scratch of 4 rows a stripe, which is all of it with --headless; with a window the FrameHandoff still
+//keeps three bool copies of the grid besides it, so there it only saves one grid out of five.
+
+#define INPLACE_STRIPES 64//not the thread count, so the scratch does not depend on it
+#define INPLACE_MIN_STRIPE_HEIGHT 8//so the 4 scratch rows of a stripe are at most half of it
+
+inline uint32 get_inplace_stripes_total(Dim cells) {
+	uint32 stripes_total = max(cells.height/INPLACE_MIN_STRIPE_HEIGHT, cast(uint32, 1));
+	return min(stripes_total, cast(uint32, INPLACE_STRIPES));
+}
+inline uint64 get_inplace_scratch_size(Dim cells) {
+	//the saved first and last rows and the two rolling rows of every stripe
+	return 4*cast(uint64, get_inplace_stripes_total(cells))*cells.width;
+}
+
+struct StepInPlaceJob {
+	bool* cells;
+	Dim cells_dim;
+	uint8* firsts;
+	uint8* lasts;
+	uint8* rolling;
+	uint32 stripes_total;
+};
+void step_inplace_stripe(StepInPlaceJob* job, uint32 stripe) {
+	Dim cells_dim = job->cells_dim;
+	uint32 width = cells_dim.width;
+	uint32 stripes_total = job->stripes_total;
+	uint32 y0 = get_stripe_begin(cells_dim.height, stripes_total, stripe);
+	uint32 y1 = get_stripe_begin(cells_dim.height, stripes_total, stripe + 1);
+	const uint8* below = &job->firsts[cast(uint64, width)*((stripe + 1)%stripes_total)];
+	uint8* prev = &job->rolling[2*cast(uint64, width)*stripe];
+	uint8* cur = prev + width;
+	memcpy(prev, &job->lasts[cast(uint64, width)*((stripe + stripes_total - 1)%stripes_total)], width);
+	for(uint32 y = y0; y < y1; y += 1) {
+		bool* row = &job->cells[cast(uint64, width)*y];
+		memcpy(cur, row, width);
+		CellRows r;
+		r.up = prev;
+		r.cur = cur;
+		r.down = (y + 1 == y1) ? below : cast(const uint8*, row + width);
+		r.new_row = row;
+		step_cells_row(r, width);
+		swap(&prev, &cur);
+	}
+}
+void step_inplace_stripes(void* data, uint32 stripe_begin, uint32 stripe_end) {
+	StepInPlaceJob* job = cast(StepInPlaceJob*, data);
+	for(uint32 stripe = stripe_begin; stripe < stripe_end; stripe += 1) {
+		step_inplace_stripe(job, stripe);
+	}
+}
+//scratch has to hold get_inplace_scratch_size
+void step_cells_inplace(WorkerPool* pool, bool* cells, Dim cells_dim, uint8* scratch) {
+	uint64 width = cells_dim.width;
+	StepInPlaceJob job;
+	job.cells = cells;
+	job.cells_dim = cells_dim;
+	job.stripes_total = get_inplace_stripes_total(cells_dim);
+	job.firsts = scratch;
+	job.lasts = scratch + job.stripes_total*width;
+	job.rolling = scratch + 2*job.stripes_total*width;
+	for_each_lt(stripe, job.stripes_total) {
+		uint32 y0 = get_stripe_begin(cells_dim.height, job.stripes_total, stripe);
+		uint32 y1 = get_stripe_begin(cells_dim.height, job.stripes_total, stripe + 1);
+		memcpy(&job.firsts[width*stripe], &cells[width*y0], width);
+		memcpy(&job.lasts[width*stripe], &cells[width*(y1 - 1)], width);
+	}
+	run_stripes(pool, step_inplace_stripes, &job, job.stripes_total);
+}
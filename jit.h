@@ -0,0 +1,448 @@
+//By Monica Moniot
+#pragma once
+//Any outer totalistic rule typed in at run time, for ENGINE_JIT on the bit grid. The neighbour
+//count of 64 cells at a time is summed into four bit planes, the rule is boiled down to a short
+//sum of products over those planes and the middle cell (counts past 8 can't happen, so they
+//are free to be whatever makes it shortest), and that circuit is compiled to x86-64 in an
+//executable page. Where it can't be compiled the same circuit is walked by rule_circuit_words.
+//<windows.h> or <sys/mman.h> have to be included before basic.h.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define LIFE_JIT 1
+#else
+#define LIFE_JIT 0
+#endif
+
+#define RULE_VARS 5//the four bits of the neighbour count from the lowest, then the middle cell
+#define RULE_MINTERMS (1<<RULE_VARS)
+#define RULE_IMPLICANTS_MAX 243//3^RULE_VARS, every variable either 0, 1 or left out
+
+//a product of literals, each variable not in mask has to match its bit of value
+struct RuleTerm {
+	uint8 value;
+	uint8 mask;
+};
+struct RuleCircuit {
+	RuleTerm terms[RULE_MINTERMS];
+	uint32 terms_total;
+};
+
+inline bool does_term_cover(RuleTerm term, uint32 minterm) {
+	return (minterm&~term.mask) == term.value;
+}
+inline uint32 count_term_literals(RuleTerm term) {
+	return RULE_VARS - popcount64(term.mask);
+}
+
+//Quine-McCluskey for the prime implicants, then the essential ones and greedily whichever
+//covers the most of what is left; small enough at 5 variables that nothing fancier pays
+RuleCircuit build_rule_circuit(uint32 rule) {
+	bool is_on[RULE_MINTERMS];
+	RuleTerm level[RULE_IMPLICANTS_MAX];
+	uint32 level_total = 0;
+	for_each_lt(minterm, cast(uint32, RULE_MINTERMS)) {
+		uint32 count = minterm&15;
+		uint32 is_alive = minterm>>4;
+		is_on[minterm] = count <= 8 and ((rule>>(count + 9*is_alive))&1);
+		if(is_on[minterm] or count > 8) {
+			RuleTerm term = {cast(uint8, minterm), 0};
+			level[level_total] = term;
+			level_total += 1;
+		}
+	}
+	RuleTerm primes[RULE_IMPLICANTS_MAX];
+	uint32 primes_total = 0;
+	while(level_total > 0) {
+		RuleTerm next[RULE_IMPLICANTS_MAX];
+		uint32 next_total = 0;
+		bool is_used[RULE_IMPLICANTS_MAX] = {};
+		for(uint32 i = 0; i < level_total; i += 1) {
+			for(uint32 j = i + 1; j < level_total; j += 1) {
+				uint32 diff = level[i].value^level[j].value;
+				if(level[i].mask != level[j].mask or popcount64(diff) != 1) continue;
+				is_used[i] = 1;
+				is_used[j] = 1;
+				RuleTerm merged = {cast(uint8, level[i].value&~diff), cast(uint8, level[i].mask|diff)};
+				bool is_new = 1;
+				for(uint32 k = 0; k < next_total; k += 1) {
+					if(next[k].value == merged.value and next[k].mask == merged.mask) is_new = 0;
+				}
+				if(is_new) {
+					next[next_total] = merged;
+					next_total += 1;
+				}
+			}
+		}
+		for(uint32 i = 0; i < level_total; i += 1) {
+			if(!is_used[i]) {
+				primes[primes_total] = level[i];
+				primes_total += 1;
+			}
+		}
+		memcpy(level, next, sizeof(RuleTerm)*next_total);
+		level_total = next_total;
+	}
+
+	RuleCircuit circuit;
+	circuit.terms_total = 0;
+	bool is_covered[RULE_MINTERMS] = {};
+	bool is_picked[RULE_IMPLICANTS_MAX] = {};
+	for(uint32 minterm = 0; minterm < RULE_MINTERMS; minterm += 1) {
+		if(!is_on[minterm] or is_covered[minterm]) continue;
+		uint32 only = 0;
+		uint32 covers_total = 0;
+		for(uint32 i = 0; i < primes_total; i += 1) {
+			if(does_term_cover(primes[i], minterm)) {
+				only = i;
+				covers_total += 1;
+			}
+		}
+		if(covers_total == 1 and !is_picked[only]) {
+			is_picked[only] = 1;
+			circuit.terms[circuit.terms_total] = primes[only];
+			circuit.terms_total += 1;
+			for(uint32 m = 0; m < RULE_MINTERMS; m += 1) {
+				if(does_term_cover(primes[only], m)) is_covered[m] = 1;
+			}
+		}
+	}
+	while(true) {
+		uint32 best = 0;
+		uint32 best_covers = 0;
+		for(uint32 i = 0; i < primes_total; i += 1) {
+			uint32 covers = 0;
+			for(uint32 m = 0; m < RULE_MINTERMS; m += 1) {
+				covers += is_on[m] and !is_covered[m] and does_term_cover(primes[i], m);
+			}
+			bool is_better = covers > best_covers or (covers == best_covers and covers > 0 and count_term_literals(primes[i]) < count_term_literals(primes[best]));
+			if(is_better) {
+				best = i;
+				best_covers = covers;
+			}
+		}
+		if(best_covers == 0) break;
+		circuit.terms[circuit.terms_total] = primes[best];
+		circuit.terms_total += 1;
+		for(uint32 m = 0; m < RULE_MINTERMS; m += 1) {
+			if(does_term_cover(primes[best], m)) is_covered[m] = 1;
+		}
+	}
+	return circuit;
+}
+
+inline uint64 eval_rule_circuit(const RuleCircuit* circuit, const uint64* vars) {
+	uint64 result = 0;
+	for(uint32 t = 0; t < circuit->terms_total; t += 1) {
+		RuleTerm term = circuit->terms[t];
+		uint64 product = ~cast(uint64, 0);
+		for(uint32 v = 0; v < RULE_VARS; v += 1) {
+			if((term.mask>>v)&1) continue;
+			product &= ((term.value>>v)&1) ? vars[v] : ~vars[v];
+		}
+		result |= product;
+	}
+	return result;
+}
+
+
+//vars holds RULE_VARS words for each word of out
+typedef void (*RuleWordsFn)(const uint64* vars, uint64* out, uint64 words_total);
+
+struct RuleJit {
+	uint32 rule;
+	RuleCircuit circuit;
+	RuleWordsFn step_words;//the compiled circuit, or rule_circuit_words when there is none
+	uint8* code;
+	uint32 code_size;
+};
+RuleJit rule_jit = {};
+
+void rule_circuit_words(const uint64* vars, uint64* out, uint64 words_total) {
+	for(uint64 w = 0; w < words_total; w += 1) {
+		out[w] = eval_rule_circuit(&rule_jit.circuit, &vars[RULE_VARS*w]);
+	}
+}
+
+
+#if LIFE_JIT
+enum X64Reg {
+	X64_RAX = 0, X64_RCX = 1, X64_RDX = 2, X64_RBX = 3, X64_RSP = 4, X64_RBP = 5, X64_RSI = 6, X64_RDI = 7,
+	X64_R8 = 8, X64_R9 = 9, X64_R10 = 10, X64_R11 = 11, X64_R12 = 12, X64_R13 = 13, X64_R14 = 14, X64_R15 = 15,
+};
+//the opcodes of op r/m64, r64
+#define X64_MOV 0x89
+#define X64_AND 0x21
+#define X64_OR 0x09
+#define X64_XOR 0x31
+#define X64_TEST 0x85
+
+struct JitBuffer {
+	uint8* code;
+	uint32 size;
+	uint32 capacity;
+};
+inline void emit_byte(JitBuffer* b, uint8 v) {
+	if(b->size < b->capacity) b->code[b->size] = v;
+	b->size += 1;
+}
+inline void emit_rex(JitBuffer* b, uint32 reg, uint32 rm) {
+	emit_byte(b, cast(uint8, 0x48|((reg>>3)<<2)|(rm>>3)));
+}
+inline void emit_op(JitBuffer* b, uint8 op, uint32 dst, uint32 src) {
+	emit_rex(b, src, dst);
+	emit_byte(b, op);
+	emit_byte(b, cast(uint8, 0xC0|((src&7)<<3)|(dst&7)));
+}
+//mov dst, [base + disp], base can't be rsp or r12
+inline void emit_load(JitBuffer* b, uint32 dst, uint32 base, uint8 disp) {
+	emit_rex(b, dst, base);
+	emit_byte(b, 0x8B);
+	emit_byte(b, cast(uint8, 0x40|((dst&7)<<3)|(base&7)));
+	emit_byte(b, disp);
+}
+//mov [base], src, base can't be rsp, rbp, r12 or r13
+inline void emit_store(JitBuffer* b, uint32 base, uint32 src) {
+	emit_rex(b, src, base);
+	emit_byte(b, 0x89);
+	emit_byte(b, cast(uint8, ((src&7)<<3)|(base&7)));
+}
+inline void emit_not(JitBuffer* b, uint32 dst) {
+	emit_rex(b, 0, dst);
+	emit_byte(b, 0xF7);
+	emit_byte(b, cast(uint8, 0xD0|(dst&7)));
+}
+inline void emit_add_imm8(JitBuffer* b, uint32 dst, uint8 imm) {
+	emit_rex(b, 0, dst);
+	emit_byte(b, 0x83);
+	emit_byte(b, cast(uint8, 0xC0|(dst&7)));
+	emit_byte(b, imm);
+}
+inline void emit_dec(JitBuffer* b, uint32 dst) {
+	emit_rex(b, 0, dst);
+	emit_byte(b, 0xFF);
+	emit_byte(b, cast(uint8, 0xC8|(dst&7)));
+}
+inline void emit_push(JitBuffer* b, uint32 reg) {
+	if(reg >= 8) emit_byte(b, 0x41);
+	emit_byte(b, cast(uint8, 0x50|(reg&7)));
+}
+inline void emit_pop(JitBuffer* b, uint32 reg) {
+	if(reg >= 8) emit_byte(b, 0x41);
+	emit_byte(b, cast(uint8, 0x58|(reg&7)));
+}
+//jz/jnz with a 32 bit offset, returns where the offset goes for patch_jump
+inline uint32 emit_jump(JitBuffer* b, uint8 cc) {
+	emit_byte(b, 0x0F);
+	emit_byte(b, cc);
+	uint32 at = b->size;
+	for_each_lt(i, 4) emit_byte(b, 0);
+	return at;
+}
+inline void patch_jump(JitBuffer* b, uint32 at, uint32 target) {
+	int32 rel = cast(int32, target) - cast(int32, at + 4);
+	if(at + 4 <= b->capacity) memcpy(&b->code[at], &rel, 4);
+}
+#define X64_JZ 0x84
+#define X64_JNZ 0x85
+
+const uint32 JIT_VAR_REGS[RULE_VARS] = {X64_RAX, X64_RBX, X64_RCX, X64_RBP, X64_R8};
+const uint32 JIT_NOT_REGS[RULE_VARS] = {X64_R9, X64_R10, X64_R11, X64_R12, X64_R13};
+const uint32 JIT_SAVED_REGS[] = {X64_RBX, X64_RBP, X64_RSI, X64_RDI, X64_R12, X64_R13, X64_R14, X64_R15};
+
+//a RuleWordsFn for the circuit: every variable and its negation sits in a register of its own,
+//each product is built in r14 and or'd into r15; returns the size, which can be past capacity
+uint32 emit_rule_circuit(JitBuffer* b, const RuleCircuit* circuit) {
+	const uint32 product_reg = X64_R14;
+	const uint32 result_reg = X64_R15;
+	uint32 saved_total = sizeof(JIT_SAVED_REGS)/sizeof(JIT_SAVED_REGS[0]);
+	for(uint32 i = 0; i < saved_total; i += 1) {
+		emit_push(b, JIT_SAVED_REGS[i]);
+	}
+#if defined(_WIN32)
+	//vars, out and words_total come in rcx, rdx and r8, the code wants them where System V puts them
+	emit_op(b, X64_MOV, X64_RDI, X64_RCX);
+	emit_op(b, X64_MOV, X64_RSI, X64_RDX);
+	emit_op(b, X64_MOV, X64_RDX, X64_R8);
+#endif
+	uint32 uses = 0;
+	uint32 not_uses = 0;
+	bool is_always = 0;
+	for(uint32 t = 0; t < circuit->terms_total; t += 1) {
+		RuleTerm term = circuit->terms[t];
+		if(term.mask == RULE_MINTERMS - 1) is_always = 1;
+		uses |= ~term.mask&term.value;
+		not_uses |= ~term.mask&~term.value;
+	}
+	emit_op(b, X64_TEST, X64_RDX, X64_RDX);
+	uint32 skip_at = emit_jump(b, X64_JZ);
+	uint32 loop = b->size;
+	for(uint32 v = 0; v < RULE_VARS; v += 1) {
+		if(((uses|not_uses)>>v)&1) emit_load(b, JIT_VAR_REGS[v], X64_RDI, cast(uint8, 8*v));
+	}
+	for(uint32 v = 0; v < RULE_VARS; v += 1) {
+		if((not_uses>>v)&1) {
+			emit_op(b, X64_MOV, JIT_NOT_REGS[v], JIT_VAR_REGS[v]);
+			emit_not(b, JIT_NOT_REGS[v]);
+		}
+	}
+	emit_op(b, X64_XOR, result_reg, result_reg);
+	if(is_always) {
+		emit_not(b, result_reg);
+	} else {
+		for(uint32 t = 0; t < circuit->terms_total; t += 1) {
+			RuleTerm term = circuit->terms[t];
+			bool is_first = 1;
+			for(uint32 v = 0; v < RULE_VARS; v += 1) {
+				if((term.mask>>v)&1) continue;
+				uint32 literal = ((term.value>>v)&1) ? JIT_VAR_REGS[v] : JIT_NOT_REGS[v];
+				emit_op(b, is_first ? X64_MOV : X64_AND, product_reg, literal);
+				is_first = 0;
+			}
+			emit_op(b, X64_OR, result_reg, product_reg);
+		}
+	}
+	emit_store(b, X64_RSI, result_reg);
+	emit_add_imm8(b, X64_RDI, 8*RULE_VARS);
+	emit_add_imm8(b, X64_RSI, 8);
+	emit_dec(b, X64_RDX);
+	uint32 loop_at = emit_jump(b, X64_JNZ);
+	patch_jump(b, loop_at, loop);
+	patch_jump(b, skip_at, b->size);
+	for(uint32 i = saved_total; i > 0; i -= 1) {
+		emit_pop(b, JIT_SAVED_REGS[i - 1]);
+	}
+	emit_byte(b, 0xC3);
+	return b->size;
+}
+
+//pages the code can be written into and then run, never both at once
+uint8* alloc_code_pages(uint32 size) {
+#if defined(_WIN32)
+	return cast(uint8*, VirtualAlloc(0, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+#else
+	void* pages = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	return (pages == MAP_FAILED) ? 0 : cast(uint8*, pages);
+#endif
+}
+bool make_code_executable(uint8* code, uint32 size) {
+#if defined(_WIN32)
+	DWORD old_protect;
+	if(!VirtualProtect(code, size, PAGE_EXECUTE_READ, &old_protect)) return 0;
+	FlushInstructionCache(GetCurrentProcess(), code, size);
+	return 1;
+#else
+	return mprotect(code, size, PROT_READ|PROT_EXEC) == 0;
+#endif
+}
+void free_code_pages(uint8* code, uint32 size) {
+#if defined(_WIN32)
+	VirtualFree(code, 0, MEM_RELEASE);
+#else
+	munmap(code, size);
+#endif
+}
+#endif
+
+//swaps in the step for the rule and frees the pages of the old one, so nothing can be stepping
+//ENGINE_JIT while it does: set_sim_rule only calls it between steps. 0 if the rule does not parse
+bool set_jit_rule(const char* rule) {
+	uint32 bits = parse_rule(rule);
+	if(bits&RULE_INVALID) return 0;
+	uint8* old_code = rule_jit.code;
+	uint32 old_code_size = rule_jit.code_size;
+	rule_jit.rule = bits;
+	rule_jit.circuit = build_rule_circuit(bits);
+	rule_jit.step_words = rule_circuit_words;
+	rule_jit.code = 0;
+	rule_jit.code_size = 0;
+#if LIFE_JIT
+	uint8 scratch[4096];
+	JitBuffer buffer = {scratch, 0, sizeof(scratch)};
+	uint32 size = emit_rule_circuit(&buffer, &rule_jit.circuit);
+	uint8* code = (size <= buffer.capacity) ? alloc_code_pages(size) : 0;
+	if(code) {
+		memcpy(code, scratch, size);
+		if(make_code_executable(code, size)) {
+			rule_jit.code = code;
+			rule_jit.code_size = size;
+			rule_jit.step_words = cast(RuleWordsFn, cast(void*, code));
+		} else {
+			free_code_pages(code, size);
+		}
+	}
+	if(old_code) free_code_pages(old_code, old_code_size);
+#endif
+	return 1;
+}
+
+
+//the neighbour count of every bit of a word as four bit planes, the same adder network as
+//step_bit_word carried on far enough to tell every count from 0 to 8 apart
+inline void get_count_planes(uint64* planes, uint64 up_w, uint64 up, uint64 up_e, uint64 cur_w, uint64 cur_e, uint64 down_w, uint64 down, uint64 down_e) {
+	uint64 up_ones   = up_w^up^up_e;
+	uint64 up_twos   = (up_w&up)|(up_e&(up_w^up));
+	uint64 cur_ones  = cur_w^cur_e;
+	uint64 cur_twos  = cur_w&cur_e;
+	uint64 down_ones = down_w^down^down_e;
+	uint64 down_twos = (down_w&down)|(down_e&(down_w^down));
+
+	uint64 carry = (up_ones&cur_ones)|(down_ones&(up_ones^cur_ones));
+	//what is left is four twos to sum, at most one pair of them can carry into the fours twice
+	uint64 a = up_twos^cur_twos;
+	uint64 a_carry = up_twos&cur_twos;
+	uint64 b = down_twos^carry;
+	uint64 b_carry = down_twos&carry;
+	uint64 ab_carry = a&b;
+	planes[0] = up_ones^cur_ones^down_ones;
+	planes[1] = a^b;
+	planes[2] = a_carry^b_carry^ab_carry;
+	planes[3] = (a_carry&b_carry)|(ab_carry&(a_carry^b_carry));
+}
+
+#define JIT_CHUNK_WORDS 64//words of planes built up before each call into the rule
+
+void step_jit_rows(const uint64* bits0, uint64* bits1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	uint64 vars[JIT_CHUNK_WORDS*RULE_VARS];
+	uint32 words_per_row = get_bit_words_per_row(cells_dim.width);
+	uint32 last_word = words_per_row - 1;
+	uint64 last_mask = get_last_word_mask(cells_dim.width);
+	RuleWordsFn step_words = rule_jit.step_words;
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		uint32 up_y = (y == 0) ? cells_dim.height - 1 : y - 1;
+		uint32 down_y = (y + 1 == cells_dim.height) ? 0 : y + 1;
+		const uint64* up_row = &bits0[cast(uint64, words_per_row)*up_y];
+		const uint64* cur_row = &bits0[cast(uint64, words_per_row)*y];
+		const uint64* down_row = &bits0[cast(uint64, words_per_row)*down_y];
+		uint64* new_row = &bits1[cast(uint64, words_per_row)*y];
+		for(uint32 w0 = 0; w0 < words_per_row; w0 += JIT_CHUNK_WORDS) {
+			uint32 words_total = min(words_per_row - w0, cast(uint32, JIT_CHUNK_WORDS));
+			for(uint32 i = 0; i < words_total; i += 1) {
+				uint32 w = w0 + i;
+				uint64* word_vars = &vars[RULE_VARS*i];
+				get_count_planes(word_vars,
+					get_west_word(up_row, w, last_word, cells_dim.width), up_row[w], get_east_word(up_row, w, last_word, cells_dim.width),
+					get_west_word(cur_row, w, last_word, cells_dim.width), get_east_word(cur_row, w, last_word, cells_dim.width),
+					get_west_word(down_row, w, last_word, cells_dim.width), down_row[w], get_east_word(down_row, w, last_word, cells_dim.width)
+				);
+				word_vars[4] = cur_row[w];
+			}
+			step_words(vars, &new_row[w0], words_total);
+		}
+		new_row[last_word] &= last_mask;
+	}
+}
+
+struct StepJitJob {
+	const uint64* bits0;
+	uint64* bits1;
+	Dim cells;
+};
+void step_jit_stripe(void* data, uint32 row_begin, uint32 row_end) {
+	StepJitJob* job = cast(StepJitJob*, data);
+	step_jit_rows(job->bits0, job->bits1, job->cells, row_begin, row_end);
+}
+//set_jit_rule has to have been called
+void step_jit_striped(WorkerPool* pool, const uint64* bits0, uint64* bits1, Dim cells) {
+	StepJitJob job = {bits0, bits1, cells};
+	run_stripes(pool, step_jit_stripe, &job, cells.height);
+}
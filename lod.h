@@ -0,0 +1,125 @@
+//By Monica Moniot
+#pragma once
+//Density pyramid for drawing the universe zoomed out. Level l holds how much of every
+//2^l x 2^l block of cells is alive, from 0 to 255; level 0 is the cells themselves, every
+//level above averages the four entries under it, and past the edges counts as dead.
+//A pixel covering more than one cell is drawn from the level whose blocks are just
+//smaller than it, so it reads a handful of entries however far out the view is.
+//Levels up to the tile size stay inside one tile and are rebuilt only for the tiles
+//that changed; the levels above that are small enough to rebuild whole.
+
+#define LOD_LEVELS_MAX 10//blocks of 1024x1024 cells, enough for the farthest the viewport zooms out
+#define LOD_TILE_LEVELS 5//2^5 is TILE_SIZE
+
+struct DensityPyramid {
+	Dim cells;
+	uint32 levels_total;//levels above 0
+	Dim level_dims[LOD_LEVELS_MAX + 1];
+	uint8* levels[LOD_LEVELS_MAX + 1];//levels[0] is unused, the cells are read instead
+	uint64 version;//the version of the cells it was last built from
+};
+
+inline Dim get_density_level_dim(Dim cells, uint32 level) {
+	uint32 block = 1<<level;
+	Dim dim = {divceil(cells.width, block), divceil(cells.height, block)};
+	return dim;
+}
+uint64 get_density_pyramid_size(Dim cells) {
+	uint64 size = 0;
+	for(uint32 level = 1; level <= LOD_LEVELS_MAX; level += 1) {
+		Dim dim = get_density_level_dim(cells, level);
+		size += cast(uint64, dim.width)*dim.height;
+		if(dim.width == 1 and dim.height == 1) break;
+	}
+	return size;
+}
+void init_density_pyramid(DensityPyramid* pyramid, byte** memory, Dim cells) {
+	memzero(pyramid, sizeof(DensityPyramid));
+	pyramid->cells = cells;
+	pyramid->level_dims[0] = cells;
+	for(uint32 level = 1; level <= LOD_LEVELS_MAX; level += 1) {
+		Dim dim = get_density_level_dim(cells, level);
+		pyramid->level_dims[level] = dim;
+		pyramid->levels[level] = claim_bytes(uint8, memory, dim.width*dim.height);
+		pyramid->levels_total = level;
+		if(dim.width == 1 and dim.height == 1) break;
+	}
+}
+
+inline uint32 get_density(const DensityPyramid* pyramid, const bool* cells, uint32 level, int64 x, int64 y) {
+	Dim dim = pyramid->level_dims[level];
+	if(cast(uint64, x) >= dim.width or cast(uint64, y) >= dim.height) return 0;
+	if(level == 0) return cells[dim.width*y + x] ? 255 : 0;
+	return pyramid->levels[level][dim.width*y + x];
+}
+//averages the four entries of the level below over [x0, x1) x [y0, y1) of level
+void build_density_entries(DensityPyramid* pyramid, const bool* cells, uint32 level, uint32 x0, uint32 x1, uint32 y0, uint32 y1) {
+	Dim dim = pyramid->level_dims[level];
+	Dim below_dim = pyramid->level_dims[level - 1];
+	uint8* entries = pyramid->levels[level];
+	//only the last row and column can hang over the edge of the level below
+	uint32 inner_x1 = min(x1, below_dim.width/2);
+	for(uint32 y = y0; y < y1; y += 1) {
+		uint32 x = x0;
+		if(2*y + 1 < below_dim.height) {
+			uint32 i0 = below_dim.width*(2*y) + 2*x;
+			uint32 i1 = i0 + below_dim.width;
+			if(level == 1) {
+				//a cell is 0 or 1, so this is the count times 255/4
+				const uint8* row0 = cast(const uint8*, cells);
+				for(; x < inner_x1; x += 1, i0 += 2, i1 += 2) {
+					uint32 alive = row0[i0] + row0[i0 + 1] + row0[i1] + row0[i1 + 1];
+					entries[dim.width*y + x] = cast(uint8, (255*alive + 2)/4);
+				}
+			} else {
+				const uint8* below = pyramid->levels[level - 1];
+				for(; x < inner_x1; x += 1, i0 += 2, i1 += 2) {
+					uint32 sum = below[i0] + below[i0 + 1] + below[i1] + below[i1 + 1];
+					entries[dim.width*y + x] = cast(uint8, (sum + 2)/4);
+				}
+			}
+		}
+		for(; x < x1; x += 1) {
+			uint32 sum = get_density(pyramid, cells, level - 1, 2*x, 2*y) + get_density(pyramid, cells, level - 1, 2*x + 1, 2*y)
+				+ get_density(pyramid, cells, level - 1, 2*x, 2*y + 1) + get_density(pyramid, cells, level - 1, 2*x + 1, 2*y + 1);
+			entries[dim.width*y + x] = cast(uint8, (sum + 2)/4);
+		}
+	}
+}
+
+//brings the pyramid up to the cells at version, rebuilding the tiles that changed after it last was
+void update_density_pyramid(DensityPyramid* pyramid, const bool* cells, const uint64* tile_versions, uint64 version) {
+	if(pyramid->version == version) return;
+	Dim tiles_dim = get_tiles_dim(pyramid->cells);
+	uint32 tile_levels = min(pyramid->levels_total, cast(uint32, LOD_TILE_LEVELS));
+	bool has_changed = false;
+	for_each_lt(tile_y, tiles_dim.height) {
+		for(uint32 tile_x = 0; tile_x < tiles_dim.width; tile_x += 1) {
+			if(tile_versions[tiles_dim.width*tile_y + tile_x] <= pyramid->version) continue;
+			has_changed = true;
+			for(uint32 level = 1; level <= tile_levels; level += 1) {
+				Dim dim = pyramid->level_dims[level];
+				uint32 shift = LOD_TILE_LEVELS - level;
+				uint32 x0 = tile_x<<shift;
+				uint32 y0 = tile_y<<shift;
+				build_density_entries(pyramid, cells, level, x0, min(x0 + (1<<shift), dim.width), y0, min(y0 + (1<<shift), dim.height));
+			}
+		}
+	}
+	if(has_changed) {
+		for(uint32 level = tile_levels + 1; level <= pyramid->levels_total; level += 1) {
+			Dim dim = pyramid->level_dims[level];
+			build_density_entries(pyramid, cells, level, 0, dim.width, 0, dim.height);
+		}
+	}
+	pyramid->version = version;
+}
+
+//the level whose blocks are the biggest that still fit in a pixel
+inline uint32 get_density_level(const DensityPyramid* pyramid, double cells_per_pixel) {
+	uint32 level = 0;
+	while(level < pyramid->levels_total and cast(double, cast(uint32, 2)<<level) <= cells_per_pixel) {
+		level += 1;
+	}
+	return level;
+}
@@ -0,0 +1,123 @@
+//By Monica Moniot
+#pragma once
+//Frame pacing for the window. Frames last a whole number of display refreshes. The time
+//left in a frame is slept away with SDL_Delay, asking for a little less than what is left by
+//how much sleeps have been overshooting lately, and only the last fraction of a millisecond
+//is spun. With vsync the sleep stops half a refresh early and the present lines it up.
+//Frames that keep running late make the frame one refresh longer, and frames that keep
+//finishing early give the refresh back. While paused with nothing to redraw the main
+//loop blocks on the event queue instead of drawing frames nobody will see.
+
+#define PACER_MAX_REFRESHES 4//the longest a frame is allowed to get, in refreshes
+#define PACER_LATE_FRAMES 8//consecutive late frames before the frame gets longer
+#define PACER_EARLY_FRAMES 120//consecutive frames that would fit a shorter frame before it gets shorter
+#define PACER_SPIN_MS .25f//below this the pacer spins instead of asking for a sleep
+#define PACER_MAX_OVERSHOOT_MS 4.0f//one descheduled sleep should not turn the next frames into spinning
+#define PACER_IDLE_WAIT_MS 500
+
+float get_delta_ms(uint64 t0, uint64 t1) {
+	return (1000.0f*(t1 - t0))/SDL_GetPerformanceFrequency();
+}
+
+struct FramePacer {
+	float refresh_ms;
+	uint32 refreshes_per_frame;
+	float ms_per_frame;
+	bool use_vsync;
+	float sleep_overshoot_ms;//how much later than asked SDL_Delay usually returns
+	uint32 late_frames;
+	uint32 early_frames;
+	uint32 fast_frames;//vsync frames that came back much sooner than a refresh
+	uint64 start_of_frame;
+	bool is_idle;
+};
+
+void init_frame_pacer(FramePacer* pacer, float refresh_ms, bool use_vsync) {
+	memzero(pacer, sizeof(FramePacer));
+	pacer->refresh_ms = refresh_ms;
+	pacer->refreshes_per_frame = 1;
+	pacer->ms_per_frame = refresh_ms;
+	pacer->use_vsync = use_vsync;
+	pacer->sleep_overshoot_ms = 1;
+	pacer->start_of_frame = SDL_GetPerformanceCounter();
+}
+
+inline float get_frame_deadline_ms(const FramePacer* pacer) {
+	return pacer->ms_per_frame - (pacer->use_vsync ? pacer->refresh_ms/2 : 0);
+}
+
+inline void set_frame_refreshes(FramePacer* pacer, uint32 refreshes_per_frame) {
+	pacer->refreshes_per_frame = refreshes_per_frame;
+	pacer->ms_per_frame = refreshes_per_frame*pacer->refresh_ms;
+	pacer->late_frames = 0;
+	pacer->early_frames = 0;
+	printf("frames are now %u refreshes long, %.2fms\n", refreshes_per_frame, pacer->ms_per_frame);
+}
+
+//work_ms is how long the frame took before it started waiting
+void wait_for_frame(FramePacer* pacer, float work_ms) {
+	if(work_ms > pacer->ms_per_frame) {
+		pacer->late_frames += 1;
+		pacer->early_frames = 0;
+		if(pacer->late_frames >= PACER_LATE_FRAMES and pacer->refreshes_per_frame < PACER_MAX_REFRESHES) {
+			set_frame_refreshes(pacer, pacer->refreshes_per_frame + 1);
+		}
+	} else if(pacer->refreshes_per_frame > 1 and work_ms < .5f*(pacer->ms_per_frame - pacer->refresh_ms)) {
+		pacer->late_frames = 0;
+		pacer->early_frames += 1;
+		if(pacer->early_frames >= PACER_EARLY_FRAMES) {
+			set_frame_refreshes(pacer, pacer->refreshes_per_frame - 1);
+		}
+	} else {
+		pacer->late_frames = 0;
+		pacer->early_frames = 0;
+	}
+
+	float deadline_ms = get_frame_deadline_ms(pacer);
+	while(true) {
+		uint64 now = SDL_GetPerformanceCounter();
+		float left_ms = deadline_ms - get_delta_ms(pacer->start_of_frame, now);
+		if(left_ms <= 0) break;
+		float sleep_ms = floorf(left_ms - pacer->sleep_overshoot_ms);
+		if(sleep_ms >= 1) {
+			SDL_Delay(cast(uint32, sleep_ms));
+			float overshoot_ms = min(get_delta_ms(now, SDL_GetPerformanceCounter()) - sleep_ms, PACER_MAX_OVERSHOOT_MS);
+			//grows right away so the next frame is not late too, shrinks back slowly
+			if(overshoot_ms > pacer->sleep_overshoot_ms) {
+				pacer->sleep_overshoot_ms = overshoot_ms;
+			} else {
+				pacer->sleep_overshoot_ms += .05f*(max(overshoot_ms, 0.0f) - pacer->sleep_overshoot_ms);
+			}
+		} else if(left_ms > PACER_SPIN_MS + pacer->sleep_overshoot_ms) {
+			SDL_Delay(0);
+		}
+		//otherwise spin out the last fraction of a millisecond
+	}
+}
+
+//call right after presenting
+void start_frame(FramePacer* pacer) {
+	uint64 now = SDL_GetPerformanceCounter();
+	if(pacer->use_vsync) {
+		//a driver can ignore vsync, then presents come back right away and nothing paces the frames
+		float frame_ms = get_delta_ms(pacer->start_of_frame, now);
+		pacer->fast_frames = (frame_ms < .75f*pacer->ms_per_frame) ? pacer->fast_frames + 1 : 0;
+		if(pacer->fast_frames >= PACER_LATE_FRAMES) {
+			printf("vsync is not being honored, pacing with sleeps\n");
+			pacer->use_vsync = 0;
+		}
+	}
+	pacer->start_of_frame = now;
+}
+
+//polls like SDL_PollEvent, except the first call after an idle frame blocks until something happens
+bool get_frame_event(FramePacer* pacer, SDL_Event* event) {
+	if(pacer->is_idle) {
+		pacer->is_idle = 0;
+		bool has_event = SDL_WaitEventTimeout(event, PACER_IDLE_WAIT_MS);
+		//the wait is not part of any frame
+		pacer->start_of_frame = SDL_GetPerformanceCounter();
+		return has_event;
+	}
+	return SDL_PollEvent(event);
+}
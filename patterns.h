@@ -0,0 +1,81 @@
+//By Monica Moniot
+#pragma once
+//A few well known starting patterns, written as rows of 'O' for alive and '.' for dead.
+//Patterns without cells are random soups of the given density.
+
+struct Pattern {
+	const char* name;
+	const char* cells;
+	float density;
+};
+
+const Pattern PATTERNS[] = {
+	{"rpentomino",
+		".OO\n"
+		"OO.\n"
+		".O.", 0},
+	{"acorn",
+		".O.....\n"
+		"...O...\n"
+		"OO..OOO", 0},
+	{"gosper",
+		"........................O...........\n"
+		"......................O.O...........\n"
+		"............OO......OO............OO\n"
+		"...........O...O....OO............OO\n"
+		"OO........O.....O...OO..............\n"
+		"OO........O...O.OO....O.O...........\n"
+		"..........O.....O.......O...........\n"
+		"...........O...O....................\n"
+		"............OO......................", 0},
+	{"soup10", 0, .1f},
+	{"soup35", 0, .35f},
+	{"soup50", 0, .5f},
+};
+const uint32 PATTERNS_TOTAL = sizeof(PATTERNS)/sizeof(PATTERNS[0]);
+
+inline Dim get_pattern_dim(const char* pattern_cells) {
+	Dim dim = {0, 0};
+	uint32 width = 0;
+	for(const char* c = pattern_cells; ; c += 1) {
+		if(*c == '\n' or *c == 0) {
+			dim.width = max(dim.width, width);
+			dim.height += 1;
+			width = 0;
+			if(*c == 0) break;
+		} else {
+			width += 1;
+		}
+	}
+	return dim;
+}
+//stamps the pattern with its top left corner at origin, wrapping around the torus
+void place_pattern_cells(bool* cells, Dim cells_dim, const char* pattern_cells, Vector origin) {
+	uint32 x = 0;
+	uint32 y = 0;
+	for(const char* c = pattern_cells; *c; c += 1) {
+		if(*c == '\n') {
+			x = 0;
+			y += 1;
+			continue;
+		}
+		uint32 cell_x = (origin.x + x)%cells_dim.width;
+		uint32 cell_y = (origin.y + y)%cells_dim.height;
+		set_cell(cells, cells_dim.width, cell_x, cell_y, *c == 'O');
+		x += 1;
+	}
+}
+
+//clears the grid and puts the pattern in the middle of it, or fills it with a soup
+void place_pattern(bool* cells, Dim cells_dim, const Pattern* pattern, PCG* rng) {
+	if(pattern->cells) {
+		memzero(cells, cells_dim.width*cells_dim.height);
+		Dim dim = get_pattern_dim(pattern->cells);
+		Vector origin = {cast(int32, (cells_dim.width - min(dim.width, cells_dim.width))/2), cast(int32, (cells_dim.height - min(dim.height, cells_dim.height))/2)};
+		place_pattern_cells(cells, cells_dim, pattern->cells, origin);
+	} else {
+		for_each_in(cell, cells, cells_dim.width*cells_dim.height) {
+			*cell = (pcg_random_uniform(rng) < pattern->density);
+		}
+	}
+}
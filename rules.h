@@ -0,0 +1,137 @@
+//By Monica Moniot
+#pragma once
+//Life-like rules other than B3/S23 and edges other than the torus, for ENGINE_RULE. The rule
+//and the boundary are template arguments, so every pair in RULE_KERNELS gets a stepper of its
+//own with the rule folded into a constant and no branch on either; any rule there steps exactly
+//as fast as Conway's does. Which one runs is picked once at startup with select_rule_kernel.
+
+//bit n of a rule is born with n neighbours and bit 9 + n survives with n
+#define RULE_INVALID (cast(uint32, 1)<<31)
+
+//parses "B3/S23" style rules, at compile time when it is handed a literal; RULE_INVALID if it is not one
+constexpr uint32 parse_rule(const char* rule) {
+	uint32 bits = 0;
+	uint32 shift = 0;
+	bool has_section = 0;
+	for(const char* c = rule; *c; c += 1) {
+		if(*c == 'B' or *c == 'b') {
+			shift = 0;
+			has_section = 1;
+		} else if(*c == 'S' or *c == 's') {
+			shift = 9;
+			has_section = 1;
+		} else if(*c >= '0' and *c <= '8' and has_section) {
+			bits |= cast(uint32, 1)<<(shift + (*c - '0'));
+		} else if(*c != '/') {
+			return RULE_INVALID;
+		}
+	}
+	return has_section ? bits : RULE_INVALID;
+}
+const uint32 CONWAY_RULE = parse_rule("B3/S23");
+
+enum Boundary {
+	BOUNDARY_TORUS = 0,
+	BOUNDARY_DEAD = 1,//everything past the edges is dead
+	BOUNDARY_KLEIN = 2,//a torus, except that coming back round the top or bottom mirrors left and right
+	BOUNDARIES_TOTAL = 3,
+};
+const char* BOUNDARY_NAMES[BOUNDARIES_TOTAL] = {"torus", "dead", "klein"};
+
+inline bool parse_boundary(const char* name, Boundary* boundary) {
+	for_each_lt(i, BOUNDARIES_TOTAL) {
+		if(strcmp(name, BOUNDARY_NAMES[i]) == 0) {
+			*boundary = cast(Boundary, i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+template<uint32 rule>
+inline bool apply_rule(uint32 total, uint32 is_alive) {
+	return (rule>>(total + 9*is_alive))&1;
+}
+
+//any cell, even one past the edge of the grid
+template<Boundary boundary>
+inline uint32 get_boundary_cell(const bool* cells, Dim cells_dim, int32 x, int32 y) {
+	int32 width = cells_dim.width;
+	int32 height = cells_dim.height;
+	if(boundary == BOUNDARY_DEAD) {
+		if(x < 0 or x >= width or y < 0 or y >= height) return 0;
+	} else {
+		x = (x + width)%width;
+		if(y < 0 or y >= height) {
+			y = (y + height)%height;
+			if(boundary == BOUNDARY_KLEIN) x = width - 1 - x;
+		}
+	}
+	return cells[cast(uint64, width)*y + x];
+}
+//the slow path for the cells on the edges, which are all that the boundary changes
+template<uint32 rule, Boundary boundary>
+inline bool step_boundary_cell(const bool* cells0, Dim cells_dim, int32 x, int32 y) {
+	uint32 total = 0;
+	for(int32 dy = -1; dy <= 1; dy += 1) {
+		for(int32 dx = -1; dx <= 1; dx += 1) {
+			if(dx != 0 or dy != 0) total += get_boundary_cell<boundary>(cells0, cells_dim, x + dx, y + dy);
+		}
+	}
+	return apply_rule<rule>(total, cells0[cast(uint64, cells_dim.width)*y + x]);
+}
+
+template<uint32 rule, Boundary boundary>
+void step_cells_rule_rows(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	static_assert(!(rule&RULE_INVALID), "rules are written like B3/S23");
+	uint32 width = cells_dim.width;
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		bool* new_row = &cells1[cast(uint64, width)*y];
+		if(y == 0 or y + 1 == cells_dim.height) {
+			for(uint32 x = 0; x < width; x += 1) {
+				new_row[x] = step_boundary_cell<rule, boundary>(cells0, cells_dim, x, y);
+			}
+			continue;
+		}
+		const uint8* up = cast(const uint8*, &cells0[cast(uint64, width)*(y - 1)]);
+		const uint8* cur = cast(const uint8*, &cells0[cast(uint64, width)*y]);
+		const uint8* down = cast(const uint8*, &cells0[cast(uint64, width)*(y + 1)]);
+		new_row[0] = step_boundary_cell<rule, boundary>(cells0, cells_dim, 0, y);
+		for(uint32 x = 1; x < width - 1; x += 1) {
+			uint32 total = up[x - 1] + up[x] + up[x + 1] + cur[x - 1] + cur[x + 1] + down[x - 1] + down[x] + down[x + 1];
+			new_row[x] = apply_rule<rule>(total, cur[x]);
+		}
+		new_row[width - 1] = step_boundary_cell<rule, boundary>(cells0, cells_dim, width - 1, y);
+	}
+}
+
+struct RuleKernels {
+	const char* rule;
+	StepRowsFn step_rows[BOUNDARIES_TOTAL];
+};
+#define RULE_KERNELS(rule) {rule, {step_cells_rule_rows<parse_rule(rule), BOUNDARY_TORUS>, step_cells_rule_rows<parse_rule(rule), BOUNDARY_DEAD>, step_cells_rule_rows<parse_rule(rule), BOUNDARY_KLEIN>}}
+//every rule that can be run, a new one only has to be added here
+const RuleKernels RULE_KERNELS_TABLE[] = {
+	RULE_KERNELS("B3/S23"),//Conway's
+	RULE_KERNELS("B36/S23"),//HighLife
+	RULE_KERNELS("B2/S"),//Seeds
+	RULE_KERNELS("B3678/S34678"),//Day & Night
+	RULE_KERNELS("B1357/S1357"),//Replicator
+	RULE_KERNELS("B368/S245"),//Morley
+	RULE_KERNELS("B3/S012345678"),//Life without Death
+};
+const uint32 RULE_KERNELS_TOTAL = sizeof(RULE_KERNELS_TABLE)/sizeof(RULE_KERNELS_TABLE[0]);
+
+StepRowsFn step_rule_rows = RULE_KERNELS_TABLE[0].step_rows[BOUNDARY_TORUS];
+//rules are matched by what they do, so "b63/s32" finds HighLife too; 0 if it was not compiled in
+bool select_rule_kernel(const char* rule, Boundary boundary) {
+	uint32 bits = parse_rule(rule);
+	if(bits&RULE_INVALID) return 0;
+	for_each_lt(i, RULE_KERNELS_TOTAL) {
+		if(parse_rule(RULE_KERNELS_TABLE[i].rule) == bits) {
+			step_rule_rows = RULE_KERNELS_TABLE[i].step_rows[boundary];
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,259 @@
+//By Monica Moniot
+#pragma once
+//Vectorized steps for the byte-per-cell grid. Interior columns are done 8/16/32/64 cells
+//at a time, only the two wrap-around columns of each row go through the scalar path.
+//The 8 at a time SWAR kernel is plain C++, for the targets with no intrinsics at all.
+//The best kernel for the host is picked once at startup with init_simd_kernels.
+//<immintrin.h>/<intrin.h> have to be included before basic.h, since it redefines malloc.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LIFE_X86 1
+#else
+#define LIFE_X86 0
+#endif
+
+#if defined(_MSC_VER)
+#define TARGET_SSE2
+#define TARGET_AVX2
+#define TARGET_AVX512BW
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+#endif
+
+enum SimdLevel {
+	SIMD_SCALAR = 0,
+	SIMD_SWAR = 1,//8 cells in a uint64, every host has it
+	SIMD_SSE2 = 2,
+	SIMD_AVX2 = 3,
+	SIMD_AVX512BW = 4,
+};
+const char* SIMD_LEVEL_NAMES[] = {"scalar", "swar", "sse2", "avx2", "avx512bw"};
+
+typedef void (*StepRowsFn)(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end);
+
+
+#if LIFE_X86
+inline void get_cpuid(uint32 regs[4], uint32 leaf, uint32 subleaf) {
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for_each_lt(i, 4) regs[i] = r[i];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+inline uint64 get_xcr0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32 lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (cast(uint64, hi)<<32)|lo;
+#endif
+}
+#endif
+
+SimdLevel detect_simd_level() {
+#if LIFE_X86
+	uint32 regs[4];
+	get_cpuid(regs, 0, 0);
+	uint32 max_leaf = regs[0];
+	if(max_leaf < 1) return SIMD_SWAR;
+	get_cpuid(regs, 1, 0);
+	bool has_sse2 = (regs[3]>>26)&1;
+	bool has_osxsave = (regs[2]>>27)&1;
+	bool has_avx = (regs[2]>>28)&1;
+	if(!has_sse2) return SIMD_SWAR;
+	if(!has_osxsave or !has_avx or max_leaf < 7) return SIMD_SSE2;
+	//the os also has to save the ymm/zmm registers on context switches
+	uint64 xcr0 = get_xcr0();
+	get_cpuid(regs, 7, 0);
+	bool has_avx2 = (regs[1]>>5)&1;
+	bool has_avx512f = (regs[1]>>16)&1;
+	bool has_avx512bw = (regs[1]>>30)&1;
+	if(has_avx512f and has_avx512bw and (xcr0&0xE6) == 0xE6) return SIMD_AVX512BW;
+	if(has_avx2 and (xcr0&0x6) == 0x6) return SIMD_AVX2;
+	return SIMD_SSE2;
+#else
+	return SIMD_SWAR;
+#endif
+}
+
+
+inline bool step_cell_byte(const uint8* up, const uint8* cur, const uint8* down, uint32 west, uint32 x, uint32 east) {
+	uint32 total_adj_cell = up[west] + up[x] + up[east] + cur[west] + cur[east] + down[west] + down[x] + down[east];
+	//cur is 0 or 1, so this is exactly (total == 3) or (cur and total == 2)
+	return (total_adj_cell|cur[x]) == 3;
+}
+//columns [x, width - 1) with no wrap, then the last column wrapping to the first
+inline void step_cells_row_tail(const uint8* up, const uint8* cur, const uint8* down, bool* new_row, uint32 x, uint32 cells_width) {
+	for(; x < cells_width - 1; x += 1) {
+		new_row[x] = step_cell_byte(up, cur, down, x - 1, x, x + 1);
+	}
+	new_row[cells_width - 1] = step_cell_byte(up, cur, down, cells_width - 2, cells_width - 1, 0);
+}
+struct CellRows {
+	const uint8* up;
+	const uint8* cur;
+	const uint8* down;
+	bool* new_row;
+};
+inline CellRows get_cell_rows(const bool* cells0, bool* cells1, Dim cells_dim, uint32 y) {
+	uint32 up_y = (y == 0) ? cells_dim.height - 1 : y - 1;
+	uint32 down_y = (y + 1 == cells_dim.height) ? 0 : y + 1;
+	CellRows rows;
+	rows.up = cast(const uint8*, &cells0[cells_dim.width*up_y]);
+	rows.cur = cast(const uint8*, &cells0[cells_dim.width*y]);
+	rows.down = cast(const uint8*, &cells0[cells_dim.width*down_y]);
+	rows.new_row = &cells1[cells_dim.width*y];
+	return rows;
+}
+//steps the one row r points at, for the steppers that keep their rows somewhere else
+typedef void (*StepRowFn)(CellRows r, uint32 cells_width);
+
+void step_cells_row_scalar(CellRows r, uint32 cells_width) {
+	r.new_row[0] = step_cell_byte(r.up, r.cur, r.down, cells_width - 1, 0, 1);
+	step_cells_row_tail(r.up, r.cur, r.down, r.new_row, 1, cells_width);
+}
+void step_cells_rows_scalar(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		step_cells_row_scalar(get_cell_rows(cells0, cells1, cells_dim, y), cells_dim.width);
+	}
+}
+
+//8 unaligned bytes as a uint64, memcpy so it is legal anywhere and compiles to one load
+inline uint64 load_cells_word(const uint8* cells) {
+	uint64 word;
+	memcpy(&word, cells, sizeof(uint64));
+	return word;
+}
+//no byte of a total ever gets past 9, so the adds never carry into the next byte and which
+//end of the word a byte sits at does not matter
+void step_cells_row_swar(CellRows r, uint32 cells_width) {
+	const uint64 ones = 0x0101010101010101ull;
+	r.new_row[0] = step_cell_byte(r.up, r.cur, r.down, cells_width - 1, 0, 1);
+	uint32 x = 1;
+	for(; x + 8 <= cells_width - 1; x += 8) {
+		//the 3-sum across each row, then down the three rows, then the middle cell back out
+		uint64 up = load_cells_word(r.up + x - 1) + load_cells_word(r.up + x) + load_cells_word(r.up + x + 1);
+		uint64 cur = load_cells_word(r.cur + x);
+		uint64 cur_total = load_cells_word(r.cur + x - 1) + cur + load_cells_word(r.cur + x + 1);
+		uint64 down = load_cells_word(r.down + x - 1) + load_cells_word(r.down + x) + load_cells_word(r.down + x + 1);
+		uint64 total = up + cur_total + down - cur;
+		//a byte of diff is 0 exactly where (total|cur) == 3, adding 0x7f sets the top bit of every other byte
+		uint64 diff = (total|cur)^(3*ones);
+		uint64 alive = (~(diff + 0x7f*ones)>>7)&ones;
+		memcpy(r.new_row + x, &alive, sizeof(uint64));
+	}
+	step_cells_row_tail(r.up, r.cur, r.down, r.new_row, x, cells_width);
+}
+void step_cells_rows_swar(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		step_cells_row_swar(get_cell_rows(cells0, cells1, cells_dim, y), cells_dim.width);
+	}
+}
+
+#if LIFE_X86
+TARGET_SSE2 void step_cells_row_sse2(CellRows r, uint32 cells_width) {
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i three = _mm_set1_epi8(3);
+	r.new_row[0] = step_cell_byte(r.up, r.cur, r.down, cells_width - 1, 0, 1);
+	uint32 x = 1;
+	for(; x + 16 <= cells_width - 1; x += 16) {
+		__m128i total = _mm_add_epi8(_mm_loadu_si128(cast(const __m128i*, r.up + x - 1)), _mm_loadu_si128(cast(const __m128i*, r.up + x)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, r.up + x + 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, r.cur + x - 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, r.cur + x + 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, r.down + x - 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, r.down + x)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, r.down + x + 1)));
+		__m128i cur = _mm_loadu_si128(cast(const __m128i*, r.cur + x));
+		__m128i alive = _mm_cmpeq_epi8(_mm_or_si128(total, cur), three);
+		_mm_storeu_si128(cast(__m128i*, r.new_row + x), _mm_and_si128(alive, one));
+	}
+	step_cells_row_tail(r.up, r.cur, r.down, r.new_row, x, cells_width);
+}
+TARGET_SSE2 void step_cells_rows_sse2(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		step_cells_row_sse2(get_cell_rows(cells0, cells1, cells_dim, y), cells_dim.width);
+	}
+}
+TARGET_AVX2 void step_cells_row_avx2(CellRows r, uint32 cells_width) {
+	const __m256i one = _mm256_set1_epi8(1);
+	const __m256i three = _mm256_set1_epi8(3);
+	r.new_row[0] = step_cell_byte(r.up, r.cur, r.down, cells_width - 1, 0, 1);
+	uint32 x = 1;
+	for(; x + 32 <= cells_width - 1; x += 32) {
+		__m256i total = _mm256_add_epi8(_mm256_loadu_si256(cast(const __m256i*, r.up + x - 1)), _mm256_loadu_si256(cast(const __m256i*, r.up + x)));
+		total = _mm256_add_epi8(total, _mm256_loadu_si256(cast(const __m256i*, r.up + x + 1)));
+		total = _mm256_add_epi8(total, _mm256_loadu_si256(cast(const __m256i*, r.cur + x - 1)));
+		total = _mm256_add_epi8(total, _mm256_loadu_si256(cast(const __m256i*, r.cur + x + 1)));
+		total = _mm256_add_epi8(total, _mm256_loadu_si256(cast(const __m256i*, r.down + x - 1)));
+		total = _mm256_add_epi8(total, _mm256_loadu_si256(cast(const __m256i*, r.down + x)));
+		total = _mm256_add_epi8(total, _mm256_loadu_si256(cast(const __m256i*, r.down + x + 1)));
+		__m256i cur = _mm256_loadu_si256(cast(const __m256i*, r.cur + x));
+		__m256i alive = _mm256_cmpeq_epi8(_mm256_or_si256(total, cur), three);
+		_mm256_storeu_si256(cast(__m256i*, r.new_row + x), _mm256_and_si256(alive, one));
+	}
+	step_cells_row_tail(r.up, r.cur, r.down, r.new_row, x, cells_width);
+}
+TARGET_AVX2 void step_cells_rows_avx2(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		step_cells_row_avx2(get_cell_rows(cells0, cells1, cells_dim, y), cells_dim.width);
+	}
+}
+TARGET_AVX512BW void step_cells_row_avx512bw(CellRows r, uint32 cells_width) {
+	const __m512i one = _mm512_set1_epi8(1);
+	const __m512i three = _mm512_set1_epi8(3);
+	r.new_row[0] = step_cell_byte(r.up, r.cur, r.down, cells_width - 1, 0, 1);
+	uint32 x = 1;
+	for(; x + 64 <= cells_width - 1; x += 64) {
+		__m512i total = _mm512_add_epi8(_mm512_loadu_si512(r.up + x - 1), _mm512_loadu_si512(r.up + x));
+		total = _mm512_add_epi8(total, _mm512_loadu_si512(r.up + x + 1));
+		total = _mm512_add_epi8(total, _mm512_loadu_si512(r.cur + x - 1));
+		total = _mm512_add_epi8(total, _mm512_loadu_si512(r.cur + x + 1));
+		total = _mm512_add_epi8(total, _mm512_loadu_si512(r.down + x - 1));
+		total = _mm512_add_epi8(total, _mm512_loadu_si512(r.down + x));
+		total = _mm512_add_epi8(total, _mm512_loadu_si512(r.down + x + 1));
+		__m512i cur = _mm512_loadu_si512(r.cur + x);
+		__mmask64 alive = _mm512_cmpeq_epi8_mask(_mm512_or_si512(total, cur), three);
+		_mm512_storeu_si512(r.new_row + x, _mm512_maskz_mov_epi8(alive, one));
+	}
+	step_cells_row_tail(r.up, r.cur, r.down, r.new_row, x, cells_width);
+}
+TARGET_AVX512BW void step_cells_rows_avx512bw(const bool* cells0, bool* cells1, Dim cells_dim, uint32 row_begin, uint32 row_end) {
+	for(uint32 y = row_begin; y < row_end; y += 1) {
+		step_cells_row_avx512bw(get_cell_rows(cells0, cells1, cells_dim, y), cells_dim.width);
+	}
+}
+#endif
+
+StepRowsFn get_step_cells_rows(SimdLevel level) {
+#if LIFE_X86
+	if(level == SIMD_AVX512BW) return step_cells_rows_avx512bw;
+	if(level == SIMD_AVX2) return step_cells_rows_avx2;
+	if(level == SIMD_SSE2) return step_cells_rows_sse2;
+#endif
+	if(level >= SIMD_SWAR) return step_cells_rows_swar;
+	return step_cells_rows_scalar;
+}
+StepRowFn get_step_cells_row(SimdLevel level) {
+#if LIFE_X86
+	if(level == SIMD_AVX512BW) return step_cells_row_avx512bw;
+	if(level == SIMD_AVX2) return step_cells_row_avx2;
+	if(level == SIMD_SSE2) return step_cells_row_sse2;
+#endif
+	if(level >= SIMD_SWAR) return step_cells_row_swar;
+	return step_cells_row_scalar;
+}
+
+SimdLevel simd_level = SIMD_SCALAR;
+StepRowsFn step_cells_rows = step_cells_rows_scalar;
+StepRowFn step_cells_row = step_cells_row_scalar;
+void init_simd_kernels() {
+	simd_level = detect_simd_level();
+	step_cells_rows = get_step_cells_rows(simd_level);
+	step_cells_row = get_step_cells_row(simd_level);
+}
@@ -0,0 +1,347 @@
+//By Monica Moniot
+#pragma once
+//Runs the Simulation on its own thread. The main thread queues edits into the pending
+//commands under a lock and posts wake; the simulation thread swaps the pending commands
+//out, applies them, steps whatever generations are due at gens_per_sec, and publishes the
+//latest generation through the FrameHandoff whenever the main thread took the last one.
+//A frame is only copied out when someone is going to look at it, not every generation.
+//Everything but the pending commands, the handoff and the atomics belongs to the simulation
+//thread once it started. If the thread could not be started, the main thread runs the same
+//loop a slice at a time with run_sim_slice instead.
+
+#define SIM_MAX_DRAWS 4096//cells drawn by the mouse in one frame
+#define SIM_SLICE_MS 4.0f//longest the simulation thread steps before checking for commands
+#define SIM_MAX_LAG_SEC .25//generations owed beyond this much time are dropped instead of caught up
+#define SIM_MAX_RULE 64//longest rule that can be typed in
+
+struct SimCommands {
+	bool quit;
+	bool toggle_pause;
+	uint32 jumps_total;
+	int32 speed_steps;//each step up doubles gens_per_sec, each step down halves it
+	char rule[SIM_MAX_RULE];//a rule to step from now on, empty if none was typed
+	uint32 draws_total;
+	Vector draws[SIM_MAX_DRAWS];//has to stay last, only the fields before it are cleared
+};
+struct SimThread {
+	SDL_Thread* thread;
+	SDL_mutex* lock;
+	SDL_sem* wake;
+	SimCommands* pending;//guarded by lock
+	SimCommands command_buffers[2];
+	FrameHandoff handoff;
+	SDL_atomic_t is_reader_waiting;
+	uint32 wake_event_type;
+
+	Simulation sim;
+	byte* memory;
+	uint64* tile_versions;
+	uint64 version;
+	uint64 redraw_version;
+	const SimFrame* published;//the last frame that went out, the reader only reads it
+	bool has_unpublished;
+	bool has_untracked_changes;//stepped by an engine that does not say which tiles changed
+	bool run_simulation;
+	float gens_per_sec;
+	uint64 last_tick;
+	double gens_owed;
+	uint32 jump_log2;
+	bool can_jump;//HashLife only knows B3/S23 on the plane, any other rule or edge would be overwritten with it
+	Boundary boundary;
+	HashLife* hashlife;
+	PCG rng;
+};
+
+inline uint64 get_sim_thread_memory_size(Dim cells, Engine engine) {
+	return get_tiles_size(cells)*sizeof(uint64) + get_simulation_memory_size(cells, engine);
+}
+inline void mark_sim_thread_redraw(SimThread* t) {
+	t->version += 1;
+	t->redraw_version = t->version;
+	for_each_lt(i, get_tiles_size(t->sim.cells)) {
+		t->tile_versions[i] = t->version;
+	}
+	t->has_unpublished = 1;
+}
+
+inline void set_sim_can_jump(SimThread* t, const char* rule) {
+	bool could_jump = t->can_jump;
+	t->can_jump = (parse_rule(rule) == CONWAY_RULE and t->boundary == BOUNDARY_TORUS);
+	if(could_jump and !t->can_jump) printf("J does nothing, HashLife only runs B3/S23 on a torus\n");
+}
+//swaps the rule the engine steps; nothing is stepping between commands, which is all the
+//rule, jit and hensel engines need to swap theirs
+void set_sim_rule(SimThread* t, const char* rule) {
+	Engine engine = t->sim.engine;
+	bool is_set = 0;
+	if(engine == ENGINE_JIT) {
+		is_set = set_jit_rule(rule);
+	} else if(engine == ENGINE_HENSEL) {
+		is_set = set_hensel_rule(rule);
+	} else if(engine == ENGINE_RULE) {
+		is_set = select_rule_kernel(rule, t->boundary);
+	} else {
+		printf("the %s engine only runs B3/S23, rules are for the rule, jit and hensel engines\n", ENGINE_NAMES[engine]);
+		return;
+	}
+	if(!is_set) {
+		printf("the %s engine can't run rule %s, the rule it had stays\n", ENGINE_NAMES[engine], rule);
+		return;
+	}
+	printf("rule %s\n", rule);
+	set_sim_can_jump(t, rule);
+}
+
+void apply_sim_commands(SimThread* t, const SimCommands* commands) {
+	Simulation* sim = &t->sim;
+	if(commands->draws_total > 0) {
+		t->version += 1;
+		Dim tiles_dim = get_tiles_dim(sim->cells);
+		for_each_lt(i, commands->draws_total) {
+			Vector cell = commands->draws[i];
+			//the viewport can show past the edges of the universe
+			if(cell.x < 0 or cell.y < 0 or cast(uint32, cell.x) >= sim->cells.width or cast(uint32, cell.y) >= sim->cells.height) continue;
+			draw_simulation_cell(sim, cell);
+			t->tile_versions[tiles_dim.width*(cell.y/TILE_SIZE) + cell.x/TILE_SIZE] = t->version;
+		}
+		t->has_unpublished = 1;
+	}
+	if(commands->rule[0]) set_sim_rule(t, commands->rule);
+	if(commands->toggle_pause) {
+		t->run_simulation ^= 1;
+		t->has_unpublished = 1;
+	}
+	for(uint32 i = 0; i < commands->jumps_total and t->can_jump; i += 1) {
+		//HashLife runs on the infinite plane, so whatever leaves the grid is lost
+		Vector origin = {-cast(int32, sim->cells.width/2), -cast(int32, sim->cells.height/2)};
+		sync_simulation_cells(sim);
+		load_hashlife_cells(t->hashlife, sim->cells0, sim->cells, origin);
+		step_hashlife(t->hashlife, t->jump_log2);
+		read_hashlife_cells(t->hashlife, sim->cells0, sim->cells, origin);
+		mark_simulation_edited(sim);
+		sim->generation += cast(uint64, 1)<<t->jump_log2;
+		mark_sim_thread_redraw(t);
+	}
+	if(commands->speed_steps != 0) {
+		for(int32 i = 0; i < commands->speed_steps; i += 1) {
+			t->gens_per_sec = (t->gens_per_sec > 0) ? 2*t->gens_per_sec : 0;
+		}
+		for(int32 i = 0; i > commands->speed_steps; i -= 1) {
+			t->gens_per_sec = (t->gens_per_sec > 0) ? max(t->gens_per_sec/2, 1.0f) : 1024;
+		}
+		printf("%.0f gens/sec\n", t->gens_per_sec);
+	}
+}
+
+//returns how many of the gens generations were stepped
+uint32 step_sim_thread(SimThread* t, uint32 gens) {
+	Simulation* sim = &t->sim;
+	uint32 gens_stepped = step_simulation_gens(sim, gens);
+	t->version += 1;
+	if(sim->engine == ENGINE_TILES) {
+		for_each_lt(i, get_tiles_size(sim->cells)) {
+			if(sim->tiles0[i]&TILE_FLIPPED) t->tile_versions[i] = t->version;
+		}
+	} else {
+		t->has_untracked_changes = 1;
+	}
+	t->has_unpublished = 1;
+	return gens_stepped;
+}
+
+//finds the tiles that differ from the last frame that went out, once per frame instead of every generation
+void track_changed_tiles(SimThread* t) {
+	Simulation* sim = &t->sim;
+	Dim cells = sim->cells;
+	const SimFrame* published = t->published;
+	t->has_untracked_changes = 0;
+	if(!published or published->cells.width != cells.width or published->cells.height != cells.height) {
+		mark_sim_thread_redraw(t);
+		return;
+	}
+	Dim tiles_dim = get_tiles_dim(cells);
+	for_each_lt(tile_y, tiles_dim.height) {
+		uint32 y0 = tile_y*TILE_SIZE;
+		uint32 y1 = min(y0 + TILE_SIZE, cells.height);
+		for(uint32 tile_x = 0; tile_x < tiles_dim.width; tile_x += 1) {
+			uint64* tile_version = &t->tile_versions[tiles_dim.width*tile_y + tile_x];
+			if(*tile_version == t->version) continue;
+			uint32 x0 = tile_x*TILE_SIZE;
+			uint32 x1 = min(x0 + TILE_SIZE, cells.width);
+			for(uint32 y = y0; y < y1; y += 1) {
+				uint32 i = cells.width*y + x0;
+				if(memcmp(&sim->cells0[i], &published->cells0[i], x1 - x0) != 0) {
+					*tile_version = t->version;
+					break;
+				}
+			}
+		}
+	}
+}
+
+//the frame still holds the generation it had at its own version, so only the tiles
+//that changed after that have to be copied, not the whole universe
+void copy_changed_tiles(SimFrame* frame, const bool* cells, const uint64* tile_versions) {
+	Dim cells_dim = frame->cells;
+	Dim tiles_dim = get_tiles_dim(cells_dim);
+	for_each_lt(tile_y, tiles_dim.height) {
+		uint32 y0 = tile_y*TILE_SIZE;
+		uint32 y1 = min(y0 + TILE_SIZE, cells_dim.height);
+		uint32 tile_x = 0;
+		while(tile_x < tiles_dim.width) {
+			if(tile_versions[tiles_dim.width*tile_y + tile_x] <= frame->version) {
+				tile_x += 1;
+				continue;
+			}
+			//a run of changed tiles is copied a row at a time
+			uint32 x0 = tile_x*TILE_SIZE;
+			while(tile_x < tiles_dim.width and tile_versions[tiles_dim.width*tile_y + tile_x] > frame->version) {
+				tile_x += 1;
+			}
+			uint32 x1 = min(tile_x*TILE_SIZE, cells_dim.width);
+			for(uint32 y = y0; y < y1; y += 1) {
+				memcpy(&frame->cells0[cells_dim.width*y + x0], &cells[cells_dim.width*y + x0], x1 - x0);
+			}
+		}
+	}
+}
+
+void publish_sim_frame(SimThread* t) {
+	Simulation* sim = &t->sim;
+	sync_simulation_cells(sim);
+	if(t->has_untracked_changes) track_changed_tiles(t);
+	SimFrame* frame = get_write_frame(&t->handoff, sim->cells);
+	copy_changed_tiles(frame, sim->cells0, t->tile_versions);
+	memcpy(frame->tile_versions, t->tile_versions, get_tiles_size(sim->cells)*sizeof(uint64));
+	frame->version = t->version;
+	frame->redraw_version = t->redraw_version;
+	frame->generation = sim->generation;
+	frame->tile_stats = sim->tile_stats;
+	frame->is_running = t->run_simulation;
+	publish_frame(&t->handoff);
+	t->published = frame;
+	t->has_unpublished = 0;
+	//the main thread is blocked on its event queue, so it has to be told
+	if(SDL_AtomicCAS(&t->is_reader_waiting, 1, 0)) {
+		SDL_Event event = {};
+		event.type = t->wake_event_type;
+		SDL_PushEvent(&event);
+	}
+}
+
+inline bool is_sim_threaded(const SimThread* t) {
+	return t->thread != 0;
+}
+
+//applies the pending commands and steps for up to SIM_SLICE_MS; *wait_ms is how long until
+//the next slice has anything to do, -1 until there are new commands. 0 once told to quit
+bool run_sim_slice(SimThread* t, int32* wait_ms) {
+	SDL_LockMutex(t->lock);
+	SimCommands* commands = t->pending;
+	t->pending = (commands == &t->command_buffers[0]) ? &t->command_buffers[1] : &t->command_buffers[0];
+	SDL_UnlockMutex(t->lock);
+	if(commands->quit) return 0;
+	apply_sim_commands(t, commands);
+	memzero(commands, sizeof(SimCommands) - sizeof(commands->draws));
+
+	uint64 now = SDL_GetPerformanceCounter();
+	float tick_ms = get_delta_ms(t->last_tick, now);
+	t->last_tick = now;
+	float gens_per_sec = t->gens_per_sec;
+	if(t->run_simulation) {
+		if(gens_per_sec > 0) {
+			t->gens_owed += gens_per_sec*tick_ms/1000.0;
+			t->gens_owed = min(t->gens_owed, max(gens_per_sec*SIM_MAX_LAG_SEC, 1.0));
+		}
+		while(gens_per_sec == 0 or t->gens_owed >= 1) {
+			//as many as are owed at once, for the engines that can step several in one pass
+			uint32 gens = (gens_per_sec > 0) ? cast(uint32, min(t->gens_owed, cast(double, TEMPORAL_GENS))) : TEMPORAL_GENS;
+			uint32 gens_stepped = step_sim_thread(t, gens);
+			if(gens_per_sec > 0) t->gens_owed -= gens_stepped;
+			if(is_frame_taken(&t->handoff)) publish_sim_frame(t);
+			if(get_delta_ms(now, SDL_GetPerformanceCounter()) > SIM_SLICE_MS) break;
+		}
+	} else {
+		t->gens_owed = 0;
+	}
+	if(t->has_unpublished and is_frame_taken(&t->handoff)) publish_sim_frame(t);
+
+	*wait_ms = -1;//until woken
+	if(t->run_simulation) {
+		*wait_ms = (gens_per_sec > 0) ? cast(int32, (1 - t->gens_owed)*1000/gens_per_sec) : 0;
+		*wait_ms = max(*wait_ms, 0);
+	}
+	//a frame is waiting for the main thread to take the last one
+	if(t->has_unpublished) *wait_ms = (*wait_ms < 0) ? 1 : min(*wait_ms, 1);
+	return 1;
+}
+
+int sim_thread_main(void* data) {
+	SimThread* t = cast(SimThread*, data);
+	int32 wait_ms;
+	while(run_sim_slice(t, &wait_ms)) {
+		if(wait_ms < 0) {
+			SDL_SemWait(t->wake);
+		} else if(wait_ms > 0) {
+			SDL_SemWaitTimeout(t->wake, wait_ms);
+		}
+	}
+	return 0;
+}
+
+//memory has to hold get_sim_thread_memory_size(cells, engine), the universe never changes size;
+//0 if the thread could not be started, then the caller has to step it with run_sim_slice
+bool init_sim_thread(SimThread* t, byte* memory, Dim cells, Engine engine, float gens_per_sec, uint32 jump_log2, const char* rule, Boundary boundary, WorkerPool* workers, HashLife* hashlife) {
+	memzero(t, sizeof(SimThread));
+	t->memory = memory;
+	t->run_simulation = 1;
+	t->gens_per_sec = gens_per_sec;
+	t->jump_log2 = jump_log2;
+	t->boundary = boundary;
+	t->can_jump = 1;
+	set_sim_can_jump(t, rule);
+	t->hashlife = hashlife;
+	pcg_seed(&t->rng, 12);
+	byte* sim_memory = memory;
+	t->tile_versions = claim_bytes(uint64, &sim_memory, get_tiles_size(cells));
+	init_simulation(&t->sim, &sim_memory, cells, engine, workers);
+	randomize_simulation(&t->sim, &t->rng, .1);
+	mark_sim_thread_redraw(t);
+
+	init_frame_handoff(&t->handoff);
+	t->pending = &t->command_buffers[0];
+	t->lock = SDL_CreateMutex();
+	t->wake = SDL_CreateSemaphore(0);
+	t->wake_event_type = SDL_RegisterEvents(1);
+	t->last_tick = SDL_GetPerformanceCounter();
+	t->thread = SDL_CreateThread(sim_thread_main, "life simulation", t);
+	return is_sim_threaded(t);
+}
+void destroy_sim_thread(SimThread* t) {
+	if(is_sim_threaded(t)) {
+		SDL_LockMutex(t->lock);
+		t->pending->quit = 1;
+		SDL_UnlockMutex(t->lock);
+		SDL_SemPost(t->wake);
+		SDL_WaitThread(t->thread, 0);
+	}
+	SDL_DestroySemaphore(t->wake);
+	SDL_DestroyMutex(t->lock);
+	destroy_frame_handoff(&t->handoff);
+}
+
+//the commands for the simulation thread to pick up next, only valid until unlock_sim_commands
+inline SimCommands* lock_sim_commands(SimThread* t) {
+	SDL_LockMutex(t->lock);
+	return t->pending;
+}
+inline void unlock_sim_commands(SimThread* t, bool has_commands) {
+	SDL_UnlockMutex(t->lock);
+	if(has_commands and is_sim_threaded(t)) SDL_SemPost(t->wake);
+}
+inline void queue_sim_draw(SimCommands* commands, Vector cell) {
+	if(commands->draws_total < SIM_MAX_DRAWS) {
+		commands->draws[commands->draws_total] = cell;
+		commands->draws_total += 1;
+	}
+}
@@ -0,0 +1,272 @@
+//By Monica Moniot
+#pragma once
+//The core of update_game with no SDL window attached: a torus of cells and the engine
+//that steps it. cells0 always holds the current generation, except with the bit and block
+//engines, where the bit or block grid is the real state and cells0 is only
+//unpacked by sync_simulation_cells. ENGINE_INPLACE steps cells0 where it is and has no cells1.
+//Anything that writes cells0 directly has to go through draw_simulation_cell or
+//mark_simulation_edited so the engine-side state follows.
+
+enum Engine {
+	ENGINE_BYTE = 0,
+	ENGINE_BITPACK = 1,
+	ENGINE_SIMD = 2,
+	ENGINE_TILES = 3,
+	ENGINE_BLOCKS = 4,
+	ENGINE_MORTON = 5,//ENGINE_BLOCKS with the blocks stored in Z order
+	ENGINE_TEMPORAL = 6,//steps up to TEMPORAL_GENS generations per pass with step_simulation_gens
+	ENGINE_INPLACE = 7,//steps cells0 in place with a few saved rows, no cells1, bit grid or tiles; the window's handoff frames still copy the grid
+	ENGINE_LUT = 8,//steps the bit grid 2x2 cells at a time through a 64KB table
+	ENGINE_COLSUM = 9,//sums each column once and shares it between the three cells across it
+	ENGINE_RULE = 10,//the rule and boundary picked with select_rule_kernel, every other engine is B3/S23 on a torus
+	ENGINE_JIT = 11,//any rule set with set_jit_rule, compiled at run time, on the bit grid and a torus
+	ENGINE_HENSEL = 12,//isotropic non-totalistic rules set with set_hensel_rule, on the bit grid and a torus
+	ENGINES_TOTAL = 13,
+};
+const char* ENGINE_NAMES[ENGINES_TOTAL] = {"byte", "bitpack", "simd", "tiles", "blocks", "morton", "temporal", "inplace", "lut", "colsum", "rule", "jit", "hensel"};
+
+inline bool is_bit_engine(Engine engine) {
+	return engine == ENGINE_BITPACK or engine == ENGINE_LUT or engine == ENGINE_JIT or engine == ENGINE_HENSEL;
+}
+inline bool is_block_engine(Engine engine) {
+	return engine == ENGINE_BLOCKS or engine == ENGINE_MORTON;
+}
+
+inline bool parse_engine(const char* name, Engine* engine) {
+	for_each_lt(i, ENGINES_TOTAL) {
+		if(strcmp(name, ENGINE_NAMES[i]) == 0) {
+			*engine = cast(Engine, i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+struct Simulation {
+	Engine engine;
+	Dim cells;
+	bool* cells0;
+	bool* cells1;//0 with ENGINE_INPLACE
+	uint64* bits0;//the bits and tiles are 0 with ENGINE_INPLACE, which only ever has cells0
+	uint64* bits1;
+	uint8* tiles0;
+	uint8* tiles1;
+	BlockGrid block_grid;//only claimed for the block engines
+	uint8* blocks0;
+	uint8* blocks1;
+	uint8* inplace_scratch;//only claimed for ENGINE_INPLACE
+	WorkerPool* workers;
+	bool are_bits_stale;//cells0 was written since the bit or block grid was last packed
+	bool are_cells_stale;//the bit or block grid was stepped since cells0 was last unpacked
+	uint64 generation;
+	TileStats tile_stats;
+};
+
+inline uint64 get_simulation_memory_size(Dim cells, Engine engine) {
+	uint64 cells_size = cast(uint64, cells.width)*cells.height;
+	if(engine == ENGINE_INPLACE) return cells_size*sizeof(bool) + get_inplace_scratch_size(cells);
+	uint64 size = 2*cells_size*sizeof(bool) + 2*get_bit_words_size(cells)*sizeof(uint64) + 2*get_tiles_size(cells);
+	//the block grid is as big as the cells again, so it is only there when it is used
+	if(is_block_engine(engine)) size += get_block_grid_memory_size(cells);
+	return size;
+}
+//points the simulation at fresh buffers for a grid of the given size, the cells are left as they are
+void claim_simulation_buffers(Simulation* sim, byte** memory, Dim cells) {
+	auto cells_size = cells.height*cells.width;
+	auto bits_size = get_bit_words_size(cells);
+	sim->cells = cells;
+	sim->cells0 = claim_bytes(bool, memory, cells_size);
+	if(sim->engine == ENGINE_INPLACE) {
+		sim->cells1 = 0;
+		sim->bits0 = 0;
+		sim->bits1 = 0;
+		sim->tiles0 = 0;
+		sim->tiles1 = 0;
+		sim->inplace_scratch = claim_bytes(uint8, memory, get_inplace_scratch_size(cells));
+		return;
+	}
+	sim->cells1 = claim_bytes(bool, memory, cells_size);
+	sim->bits0 = claim_bytes(uint64, memory, bits_size);
+	sim->bits1 = claim_bytes(uint64, memory, bits_size);
+	sim->tiles0 = claim_bytes(uint8, memory, get_tiles_size(cells));
+	sim->tiles1 = claim_bytes(uint8, memory, get_tiles_size(cells));
+	if(is_block_engine(sim->engine)) {
+		uint64 blocks_size = cast(uint64, get_blocks_size(cells))*BLOCK_CELLS;
+		sim->blocks0 = claim_bytes(uint8, memory, blocks_size);
+		sim->blocks1 = claim_bytes(uint8, memory, blocks_size);
+		init_block_grid(&sim->block_grid, memory, cells, sim->engine == ENGINE_MORTON);
+	}
+}
+
+void init_simulation(Simulation* sim, byte** memory, Dim cells, Engine engine, WorkerPool* workers) {
+	assert(cells.width > 3 and cells.height > 3);
+	memzero(sim, sizeof(Simulation));
+	sim->engine = engine;
+	sim->workers = workers;
+	claim_simulation_buffers(sim, memory, cells);
+	memzero(sim->cells0, cells.width*cells.height);
+	if(sim->cells1) memzero(sim->cells1, cells.width*cells.height);
+	if(is_block_engine(engine)) {
+		//the unused cells of the edge blocks start out dead, they are never read back as cells
+		memzero(sim->blocks0, cast(uint64, get_blocks_size(cells))*BLOCK_CELLS);
+		memzero(sim->blocks1, cast(uint64, get_blocks_size(cells))*BLOCK_CELLS);
+	}
+	if(engine == ENGINE_LUT) build_life_table();
+	if(engine == ENGINE_JIT and !rule_jit.step_words) set_jit_rule("B3/S23");
+	if(engine == ENGINE_HENSEL and !is_hensel_rule_set) set_hensel_rule("B3/S23");
+	sim->are_bits_stale = 1;
+	if(sim->tiles0) mark_all_tiles_changed(sim->tiles0, cells);
+}
+void randomize_simulation(Simulation* sim, PCG* rng, float density) {
+	for_each_in(cell, sim->cells0, sim->cells.width*sim->cells.height) {
+		*cell = (pcg_random_uniform(rng) < density);
+	}
+	sim->are_bits_stale = 1;
+	sim->are_cells_stale = 0;
+	if(sim->tiles0) mark_all_tiles_changed(sim->tiles0, sim->cells);
+}
+
+inline void sync_simulation_cells(Simulation* sim) {
+	if(sim->are_cells_stale) {
+		if(is_block_engine(sim->engine)) {
+			unpack_blocks(&sim->block_grid, sim->cells0, sim->blocks0);
+		} else {
+			unpack_bits(sim->cells0, sim->bits0, sim->cells);
+		}
+		sim->are_cells_stale = 0;
+	}
+}
+//call after writing cells0 by hand, which needs a sync_simulation_cells before it
+inline void mark_simulation_edited(Simulation* sim) {
+	sim->are_bits_stale = 1;
+	if(sim->tiles0) mark_all_tiles_changed(sim->tiles0, sim->cells);
+}
+inline void draw_simulation_cell(Simulation* sim, Vector cell) {
+	if(is_block_engine(sim->engine) and !sim->are_bits_stale) {
+		//the blocks are the universe, so the edit goes there and cells0 is only kept up with
+		//while it is current, a brush stroke never unpacks or repacks the whole grid
+		set_block_cell(&sim->block_grid, sim->blocks0, cell, 1);
+		if(!sim->are_cells_stale) set_cell(sim->cells0, sim->cells.width, cell, 1);
+		return;
+	}
+	if(is_bit_engine(sim->engine) and !sim->are_bits_stale) {
+		//the same for the bit grid
+		set_bit(sim->bits0, get_bit_words_per_row(sim->cells.width), cell.x, cell.y, 1);
+		if(!sim->are_cells_stale) set_cell(sim->cells0, sim->cells.width, cell, 1);
+		return;
+	}
+	sync_simulation_cells(sim);
+	set_cell(sim->cells0, sim->cells.width, cell, 1);
+	if(sim->tiles0) mark_tile_changed(sim->tiles0, sim->cells, cell);
+	sim->are_bits_stale = 1;
+}
+
+
+//the original brute force walk, kept as the reference every other engine has to match
+void step_cells(const bool* cells0, bool* cells1, Dim cells) {
+	uint32 up_row  = (cells.height - 2)*cells.width;
+	uint32 cur_row = (cells.height - 1)*cells.width;
+	for(uint32 down_row = 0; down_row < cells.width*cells.height; down_row += cells.width) {
+		uint32 up_col   = cells.width - 2;
+		uint32 cur_col  = cells.width - 1;
+		for_each_lt(down_col, cells.width) {
+			uint8 total_adj_cell = 0;
+			total_adj_cell += cells0[up_row   + up_col];
+			total_adj_cell += cells0[up_row   + cur_col];
+			total_adj_cell += cells0[up_row   + down_col];
+			total_adj_cell += cells0[cur_row  + up_col];
+			total_adj_cell += cells0[cur_row  + down_col];
+			total_adj_cell += cells0[down_row + up_col];
+			total_adj_cell += cells0[down_row + cur_col];
+			total_adj_cell += cells0[down_row + down_col];
+			bool new_state = ((total_adj_cell == 3) or (cells0[cur_row + cur_col] and total_adj_cell == 2));
+			cells1[cur_row + cur_col] = new_state;
+
+			up_col = cur_col;
+			cur_col = down_col;
+		}
+		up_row = cur_row;
+		cur_row = down_row;
+	}
+}
+
+//steps up to gens generations and returns how many it did, only ENGINE_TEMPORAL does more than one at a time
+uint32 step_simulation_gens(Simulation* sim, uint32 gens) {
+	Dim cells = sim->cells;
+	uint32 gens_stepped = 1;
+	if(is_bit_engine(sim->engine)) {
+		if(sim->are_bits_stale) {
+			sync_simulation_cells(sim);
+			pack_cells(sim->bits0, sim->cells0, cells);
+			sim->are_bits_stale = 0;
+		}
+		if(sim->engine == ENGINE_LUT) {
+			step_lut_striped(sim->workers, sim->bits0, sim->bits1, cells);
+		} else if(sim->engine == ENGINE_JIT) {
+			step_jit_striped(sim->workers, sim->bits0, sim->bits1, cells);
+		} else if(sim->engine == ENGINE_HENSEL) {
+			step_hensel_striped(sim->workers, sim->bits0, sim->bits1, cells);
+		} else {
+			step_bits_striped(sim->workers, sim->bits0, sim->bits1, cells);
+		}
+		swap(&sim->bits0, &sim->bits1);
+		sim->are_cells_stale = 1;
+	} else if(is_block_engine(sim->engine)) {
+		if(sim->are_bits_stale) {
+			sync_simulation_cells(sim);
+			pack_blocks(&sim->block_grid, sim->blocks0, sim->cells0);
+			sim->are_bits_stale = 0;
+		}
+		step_blocks_striped(sim->workers, &sim->block_grid, sim->blocks0, sim->blocks1);
+		swap(&sim->blocks0, &sim->blocks1);
+		sim->are_cells_stale = 1;
+	} else if(sim->engine == ENGINE_INPLACE) {
+		step_cells_inplace(sim->workers, sim->cells0, cells, sim->inplace_scratch);
+		sim->are_bits_stale = 1;
+	} else {
+		if(sim->engine == ENGINE_SIMD) {
+			step_cells_striped(sim->workers, step_cells_rows, sim->cells0, sim->cells1, cells);
+		} else if(sim->engine == ENGINE_COLSUM) {
+			step_cells_striped(sim->workers, step_cells_rows_colsum, sim->cells0, sim->cells1, cells);
+		} else if(sim->engine == ENGINE_RULE) {
+			step_cells_striped(sim->workers, step_rule_rows, sim->cells0, sim->cells1, cells);
+		} else if(sim->engine == ENGINE_TILES) {
+			sim->tile_stats = step_cells_tiled(sim->workers, sim->cells0, sim->cells1, sim->tiles0, sim->tiles1, cells);
+			swap(&sim->tiles0, &sim->tiles1);
+		} else if(sim->engine == ENGINE_TEMPORAL) {
+			gens_stepped = max(min(gens, cast(uint32, TEMPORAL_GENS)), 1u);
+			step_cells_temporal(sim->workers, sim->cells0, sim->cells1, cells, gens_stepped);
+		} else {
+			step_cells(sim->cells0, sim->cells1, cells);
+		}
+		swap(&sim->cells0, &sim->cells1);
+		sim->are_bits_stale = 1;
+	}
+	sim->generation += gens_stepped;
+	return gens_stepped;
+}
+inline void step_simulation(Simulation* sim) {
+	step_simulation_gens(sim, 1);
+}
+
+uint64 get_simulation_population(Simulation* sim) {
+	if(is_bit_engine(sim->engine) and !sim->are_bits_stale) {
+		//a popcount a word instead of unpacking the whole grid
+		return count_bits_population(sim->bits0, sim->cells);
+	}
+	sync_simulation_cells(sim);
+	uint64 total = 0;
+	for_each_in(cell, sim->cells0, sim->cells.width*sim->cells.height) {
+		total += *cell;
+	}
+	return total;
+}
+//FNV-1a over the live cells, identical for every engine that agrees on the generation
+uint64 hash_simulation_cells(Simulation* sim) {
+	sync_simulation_cells(sim);
+	uint64 hash = 0xcbf29ce484222325ull;
+	for_each_in(cell, sim->cells0, sim->cells.width*sim->cells.height) {
+		hash = (hash^(*cell))*0x100000001b3ull;
+	}
+	return hash;
+}
@@ -1,78 +1,147 @@
 #include <stdio.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 #include "SDL.h"
 #include "basic.h"
 #include "math.h"
 #include "assert.h"
 #include "random.hh"
+#include "grid.h"
+#include "bitgrid.h"
+#include "simd.h"
+#include "workers.h"
+#include "hashlife.h"
+#include "tiles.h"
+#include "blockgrid.h"
+#include "temporal.h"
+#include "inplace.h"
+#include "lut.h"
+#include "colsum.h"
+#include "rules.h"
+#include "jit.h"
+#include "hensel.h"
+#include "simulation.h"
+#include "pacer.h"
+#include "handoff.h"
+#include "simthread.h"
+#include "viewport.h"
+#include "lod.h"
+#include "textures.h"
 #undef main
 
 
-struct Vector {
-	int32 x;
-	int32 y;
-};
-struct Dim {
-	uint32 width;
-	uint32 height;
-};
-
-#define BUTTONS_TOTAL 5
+#define BUTTONS_TOTAL 7
 enum InputType {
 	INPUT_NULL = 0,
 	M1 = 1,
 	M2 = 2,
 	M3 = 3,
+	JUMP = 4,
+	FASTER = 5,
+	SLOWER = 6,
 	SPACE = BUTTONS_TOTAL,
 };
 struct GameInput {
 	uint32 button_presses[8];
 	bool is_down[8];
 	Vector mouse_move_plus_one;
+	int32 wheel_ticks;
 	Dim window_resize;
 	Dim bitmap_resize;
+	char rule[SIM_MAX_RULE];//typed after pressing R and finished with enter this frame, empty if not
+};
+struct GameConfig {
+	Dim universe;
+	Engine engine;
+	uint32 jump_log2;//pressing J advances the universe 2^jump_log2 generations with HashLife
+	const char* rule;//what the engine starts out stepping, only the rule, jit and hensel engines run anything but B3/S23 on a torus, and take another one typed after pressing R
+	Boundary boundary;
+	float gens_per_sec;//0 steps generations as fast as the simulation thread can
+};
+//the texture can be written in a narrower format the renderer takes without converting, the
+//GPU turns it back into colour when it draws the texture. That only saves the bytes written
+//into the locked texture: the GL and D3D renderers widen narrow streaming textures to 32 bits
+//on upload, so the bandwidth to the GPU is the same. auto, the default, takes the narrowest
+//the renderer supports and argb8888 is the fallback
+struct PixelFormat {
+	const char* name;
+	uint32 sdl_format;
+	uint32 bytes_per_pixel;
+	uint32 alive;//alive and dead as pixels of this format, filled in by choose_pixel_format
+	uint32 dead;
+	uint32 shades[256];//from dead to alive, for how much of what a pixel covers is alive
 };
+//narrowest first
+const PixelFormat PIXEL_FORMATS[] = {
+	{"rgb332", SDL_PIXELFORMAT_RGB332, 1, 0, 0, {}},
+	{"rgb565", SDL_PIXELFORMAT_RGB565, 2, 0, 0, {}},
+	{"argb8888", SDL_PIXELFORMAT_ARGB8888, 4, 0, 0, {}},
+};
+const uint32 PIXEL_FORMATS_TOTAL = sizeof(PIXEL_FORMATS)/sizeof(PIXEL_FORMATS[0]);
+#define PIXEL_FORMAT_FALLBACK (PIXEL_FORMATS_TOTAL - 1)
+
+//a format name or auto
+inline bool is_pixel_format_name(const char* name) {
+	if(strcmp(name, "auto") == 0) return 1;
+	for_each_lt(i, PIXEL_FORMATS_TOTAL) {
+		if(strcmp(name, PIXEL_FORMATS[i].name) == 0) return 1;
+	}
+	return 0;
+}
+
 struct PlatformData {
 	Dim screen;
 	Dim bitmap;
 	Vector mouse;
-	bool button_is_down[5];
+	bool button_is_down[BUTTONS_TOTAL + 1];
+	WorkerPool* workers;
+	HashLife* hashlife;
+	GameConfig config;
+	PixelFormat pixel_format;
+	uint64 game_memory_size;
 };
+#define MAX_DIRTY_RECTS 64//past this many the whole bitmap is redrawn
+
+//bitmap is not owned by the game, the platform points it at the locked texture before render_game
 struct RenderData {
-	uint32* bitmap;
-	uint32 bitmap_pitch;
+	byte* bitmap;
+	uint32 bitmap_pitch;//in bytes
+	uint32 dirty_rects_total;//the platform has to lock each of these, or the parts of them each texture holds, and call render_game on it
+	SDL_Rect dirty_rects[MAX_DIRTY_RECTS];
+	TileStats tile_stats;
+	uint64 gens_stepped;
+	bool is_idle;//no new generation and nothing to draw, the platform can wait for input
 };
 struct UserData {
 	bool is_dragging;
 	Vector last_cell_in_drag;
+	bool is_panning;
 };
 struct GameState {
 	PlatformData platform;
 	UserData user;
 	uint32 steps;
-	Dim cells;
-	bool is_first_cells_active;
-	bool run_simulation;
-	PCG rng;
+	SimThread sim_thread;
+	SimFrame* frame;//the latest generation taken from the simulation thread
+	Viewport view;
+	Viewport drawn_view;
+	DensityPyramid density;
+	uint64 drawn_version;
+	uint64 drawn_generation;
+	bool is_redraw_needed;//the texture was recreated and holds nothing yet
 };
 
-
-inline bool get_cell(const bool* cells, uint32 cells_width, Vector pos) {
-	auto cell = &cells[cells_width*pos.y + pos.x];
-	return *cell;
-}
-inline void set_cell(bool* cells, uint32 cells_width, Vector pos, bool state) {
-	auto cell = &cells[cells_width*pos.y + pos.x];
-	*cell = (state);
-}
-inline bool get_cell(const bool* cells, uint32 cells_width, int32 x, int32 y) {
-	Vector v = {x, y};
-	return get_cell(cells, cells_width, v);
-}
-inline void set_cell(bool* cells, uint32 cells_width, int32 x, int32 y, bool state) {
-	Vector v = {x, y};
-	set_cell(cells, cells_width, v, state);
-}
-
 inline Vector convert_coord(Dim dest, Dim origin, Vector v) {
 	Vector w = {cast(int32, v.x*dest.width/origin.width), cast(int32, v.y*dest.height/origin.height)};
 	return w;
@@ -87,116 +156,225 @@ inline Vector lerp(Vector v0, Vector v1, float t) {
 
 void initialize_game(byte* game_memory, const PlatformData* platform) {
 	GameState* game_state = claim_bytes(GameState, &game_memory, 1);
-	uint32 cells_width = platform->bitmap.width;
-	uint32 cells_height = platform->bitmap.height;
-	uint32 cells_size = cells_height*cells_width;
-	assert(cells_width > 3 and cells_height > 3);
-
-	bool* cells = claim_bytes(bool, &game_memory, cells_size);
-	bool* new_cells = claim_bytes(bool, &game_memory, cells_size);
+	Dim cells = platform->config.universe;
 
 	memzero(game_state, sizeof(GameState));
 	game_state->platform = *platform;
 	// game_state->user.last_cell_in_drag.x = 0
 	// game_state->steps = 0;
 	// game_state->steps = 0;
-	game_state->cells.width = cells_width;
-	game_state->cells.height = cells_height;
-	game_state->is_first_cells_active = 1;
-	game_state->run_simulation = 1;
-	pcg_seed(&game_state->rng, 12);
+	game_state->is_redraw_needed = 1;
+	center_viewport(&game_state->view, cells, platform->bitmap);
+
+	//the simulation thread gets its own part of the memory, the density pyramid the rest
+	const GameConfig* config = &platform->config;
+	uint64 sim_thread_memory_size = get_sim_thread_memory_size(cells, config->engine);
+	assert(sim_thread_memory_size + get_density_pyramid_size(cells) <= platform->game_memory_size - sizeof(GameState));
+	byte* density_memory = game_memory + sim_thread_memory_size;
+	init_density_pyramid(&game_state->density, &density_memory, cells);
+	if(!init_sim_thread(&game_state->sim_thread, game_memory, cells, config->engine, config->gens_per_sec, config->jump_log2, config->rule, config->boundary, platform->workers, platform->hashlife)) {
+		printf("Could not create the simulation thread: %s, stepping on the main thread instead.\n", SDL_GetError());
+	}
+}
+void shutdown_game(byte* game_memory) {
+	GameState* game_state = claim_bytes(GameState, &game_memory, 1);
+	destroy_sim_thread(&game_state->sim_thread);
+}
+
+inline void set_pixel(byte* row, uint32 x, uint32 bytes_per_pixel, uint32 pixel) {
+	if(bytes_per_pixel == 1) {
+		row[x] = cast(uint8, pixel);
+	} else if(bytes_per_pixel == 2) {
+		cast(uint16*, row)[x] = cast(uint16, pixel);
+	} else {
+		cast(uint32*, row)[x] = pixel;
+	}
+}
+//draws the cells the viewport puts under rect, pixels points at the top left of rect and
+//pixels_pitch is in bytes; past the edges of the universe is drawn dead.
+//The cost goes with the pixels drawn, not with the size of the universe
+void render_from_cells(byte* pixels, uint32 pixels_pitch, const PixelFormat* format, const bool* cells, Dim cells_dim, const Viewport* view, SDL_Rect rect) {
+	uint32 bytes_per_pixel = format->bytes_per_pixel;
+	double cells_per_pixel = 1/view->zoom;
+	//along a row the cell is stepped in 32.32 fixed point, one add per pixel, always from the
+	//left edge of the bitmap so a pixel shows the same cell whichever rect it is drawn in
+	int64 step = cast(int64, cells_per_pixel*4294967296.0);
+	int64 x_start = cast(int64, floor((view->x + .5*cells_per_pixel)*4294967296.0)) + step*rect.x;
+	for_each_lt(i, cast(uint32, rect.h)) {
+		byte* row = pixels + pixels_pitch*i;
+		int64 y = cast(int64, floor(view->y + (rect.y + i + .5)*cells_per_pixel));
+		if(y < 0 or y >= cells_dim.height) {
+			for(uint32 j = 0; j < cast(uint32, rect.w); j += 1) set_pixel(row, j, bytes_per_pixel, format->dead);
+			continue;
+		}
+		const bool* cells_row = &cells[cells_dim.width*y];
+		int64 x = x_start;
+		//split by size so each loop is a plain store
+		if(bytes_per_pixel == 1) {
+			for(uint32 j = 0; j < cast(uint32, rect.w); j += 1, x += step) {
+				uint64 cell_x = x>>32;
+				row[j] = (cell_x < cells_dim.width and cells_row[cell_x]) ? format->alive : format->dead;
+			}
+		} else if(bytes_per_pixel == 2) {
+			uint16* row16 = cast(uint16*, row);
+			for(uint32 j = 0; j < cast(uint32, rect.w); j += 1, x += step) {
+				uint64 cell_x = x>>32;
+				row16[j] = (cell_x < cells_dim.width and cells_row[cell_x]) ? format->alive : format->dead;
+			}
+		} else {
+			uint32* row32 = cast(uint32*, row);
+			for(uint32 j = 0; j < cast(uint32, rect.w); j += 1, x += step) {
+				uint64 cell_x = x>>32;
+				row32[j] = (cell_x < cells_dim.width and cells_row[cell_x]) ? format->alive : format->dead;
+			}
+		}
+	}
+}
 
-	for_each_in(cell, cells, cells_size) {
-		*cell = (pcg_random_uniform(&game_state->rng) < .1);
+//for pixels that cover more than one cell: each shows how much of its block is alive,
+//read from the density pyramid
+void render_density(byte* pixels, uint32 pixels_pitch, const PixelFormat* format, const DensityPyramid* pyramid, const bool* cells, const Viewport* view, SDL_Rect rect) {
+	double cells_per_pixel = 1/view->zoom;
+	uint32 level = get_density_level(pyramid, cells_per_pixel);
+	double blocks_per_pixel = cells_per_pixel/(cast(uint32, 1)<<level);
+	double block_x = view->x/(cast(uint32, 1)<<level);
+	double block_y = view->y/(cast(uint32, 1)<<level);
+	for_each_lt(i, cast(uint32, rect.h)) {
+		byte* row = pixels + pixels_pitch*i;
+		uint32 y = rect.y + i;
+		int64 y0 = cast(int64, floor(block_y + y*blocks_per_pixel));
+		int64 y1 = max(cast(int64, ceil(block_y + (y + 1)*blocks_per_pixel)), y0 + 1);
+		for(uint32 j = 0; j < cast(uint32, rect.w); j += 1) {
+			uint32 x = rect.x + j;
+			int64 x0 = cast(int64, floor(block_x + x*blocks_per_pixel));
+			int64 x1 = max(cast(int64, ceil(block_x + (x + 1)*blocks_per_pixel)), x0 + 1);
+			uint32 sum = 0;
+			for(int64 entry_y = y0; entry_y < y1; entry_y += 1) {
+				for(int64 entry_x = x0; entry_x < x1; entry_x += 1) {
+					sum += get_density(pyramid, cells, level, entry_x, entry_y);
+				}
+			}
+			set_pixel(row, j, format->bytes_per_pixel, format->shades[sum/((y1 - y0)*(x1 - x0))]);
+		}
 	}
-	memzero(new_cells, cells_size);
 }
 
-void render_from_cells(uint32* pixels, bool* cells, Dim cells_dim, Dim pixels_dim) {
-	for(uint32 row = 0; row < cells_dim.width*cells_dim.height; row += cells_dim.width) {
-		for_each_lt(x, cells_dim.width) {
-			bool cur_cell = cells[row + x];
-			pixels[row + x] = cur_cell ? 0xFFFFFF : 0x111111;
+inline void add_dirty_rect(RenderData* render_data, int32 x, int32 y, uint32 width, uint32 height) {
+	if(render_data->dirty_rects_total < MAX_DIRTY_RECTS) {
+		SDL_Rect rect = {x, y, cast(int, width), cast(int, height)};
+		render_data->dirty_rects[render_data->dirty_rects_total] = rect;
+	}
+	//counts past the end, so overflowing can be told apart from fitting exactly
+	render_data->dirty_rects_total += 1;
+}
+inline bool is_cell_in_universe(Dim cells, Vector cell) {
+	return cast(uint32, cell.x) < cells.width and cast(uint32, cell.y) < cells.height;
+}
+//the pixels that can show cell, clipped to bitmap
+inline SDL_Rect get_cell_rect(const Viewport* view, Vector cell, Dim bitmap) {
+	int32 x0, x1, y0, y1;
+	get_viewport_span(view->x, view->zoom, cell.x, cell.x + 1, bitmap.width, &x0, &x1);
+	get_viewport_span(view->y, view->zoom, cell.y, cell.y + 1, bitmap.height, &y0, &y1);
+	SDL_Rect rect = {x0, y0, max(x1 - x0, 0), max(y1 - y0, 0)};
+	return rect;
+}
+//one rect for each run of changed tiles in a row of visible tiles, grown downwards while
+//the rows below have the same run
+void add_changed_tiles(RenderData* render_data, const uint64* tile_versions, uint64 drawn_version, Dim cells, const Viewport* view, Dim bitmap) {
+	Dim tiles_dim = get_tiles_dim(cells);
+	//only the tiles in view are looked at
+	double view_x1 = view->x + bitmap.width/view->zoom;
+	double view_y1 = view->y + bitmap.height/view->zoom;
+	if(view_x1 <= 0 or view_y1 <= 0 or view->x >= cells.width or view->y >= cells.height) return;
+	uint32 tile_x0 = cast(uint32, max(view->x, 0.0))/TILE_SIZE;
+	uint32 tile_y0 = cast(uint32, max(view->y, 0.0))/TILE_SIZE;
+	uint32 tile_x1 = min(cast(uint32, ceil(view_x1))/TILE_SIZE + 1, tiles_dim.width);
+	uint32 tile_y1 = min(cast(uint32, ceil(view_y1))/TILE_SIZE + 1, tiles_dim.height);
+	for(uint32 tile_y = tile_y0; tile_y < tile_y1; tile_y += 1) {
+		int32 y0, y1;
+		get_viewport_span(view->y, view->zoom, tile_y*TILE_SIZE, min((tile_y + 1)*TILE_SIZE, cells.height), bitmap.height, &y0, &y1);
+		if(y0 >= y1) continue;
+		uint32 tile_x = tile_x0;
+		while(tile_x < tile_x1) {
+			if(tile_versions[tiles_dim.width*tile_y + tile_x] <= drawn_version) {
+				tile_x += 1;
+				continue;
+			}
+			uint32 run_start = tile_x;
+			while(tile_x < tile_x1 and tile_versions[tiles_dim.width*tile_y + tile_x] > drawn_version) {
+				tile_x += 1;
+			}
+			int32 x0, x1;
+			get_viewport_span(view->x, view->zoom, run_start*TILE_SIZE, min(tile_x*TILE_SIZE, cells.width), bitmap.width, &x0, &x1);
+			if(x0 >= x1) continue;
+			bool is_merged = false;
+			for(uint32 i = 0; i < min(render_data->dirty_rects_total, cast(uint32, MAX_DIRTY_RECTS)); i += 1) {
+				SDL_Rect* rect = &render_data->dirty_rects[i];
+				//the padding makes the rows overlap a little
+				if(rect->x == x0 and rect->w == x1 - x0 and rect->y <= y0 and y0 <= rect->y + rect->h) {
+					rect->h = max(rect->y + rect->h, y1) - rect->y;
+					is_merged = true;
+					break;
+				}
+			}
+			if(!is_merged) add_dirty_rect(render_data, x0, y0, x1 - x0, y1 - y0);
 		}
 	}
 }
+
 RenderData* update_game(byte* game_memory, byte* trans_memory, GameInput input) {
-	byte* game_memory_start = game_memory;
 	GameState* game_state = claim_bytes(GameState, &game_memory, 1);
+	SimThread* sim_thread = &game_state->sim_thread;
 
 	auto steps = game_state->steps;
-	auto cells = game_state->cells;
-	auto cells_size = cells.height*cells.width;
-
-	bool* cells0 = claim_bytes(bool, &game_memory, cells_size);
-	bool* cells1 = claim_bytes(bool, &game_memory, cells_size);
-	uint32* pixels = claim_bytes(uint32, &game_memory, cells_size);
+	auto bitmap = game_state->platform.bitmap;
+	Viewport* view = &game_state->view;
 
 	RenderData* ret = claim_bytes(RenderData, &trans_memory, 1);
-	ret->bitmap = pixels;
-	ret->bitmap_pitch = 4*cells.width;
+	ret->bitmap = 0;
+	ret->bitmap_pitch = 0;
+	ret->tile_stats = {};
 
-	if(!game_state->is_first_cells_active) {
-		swap(&cells0, &cells1);
-	}
-
-	bool do_render_update = false;
+	SimCommands* commands = lock_sim_commands(sim_thread);
+	bool has_commands = false;
 	if(input.window_resize.width > 0) {
 		Dim screen = input.window_resize;
 		Dim new_bitmap = input.bitmap_resize;
-		Dim new_cells = new_bitmap;
-		auto new_cells_size = screen.height*screen.width;
 		// printf("%d, %d, %d, %d\n", screen.width, screen.height, new_bitmap.width, new_bitmap.height);
-
-		byte* new_game_memory = game_memory_start;
-		claim_bytes(GameState, &new_game_memory, 1);
-		bool* new_cells0 = claim_bytes(bool, &new_game_memory, new_cells_size);
-		bool* new_cells1 = claim_bytes(bool, &new_game_memory, new_cells_size);
-		uint32* new_pixels = claim_bytes(uint32, &new_game_memory, new_cells_size);
-		if(!game_state->is_first_cells_active) {
-			swap(&new_cells0, &new_cells1);
-		}
-
-		// memzero(trans_memory, new_cells_size);
-		for_each_in(cell, trans_memory, new_cells_size) {
-			*cell = (pcg_random_uniform(&game_state->rng) < .1);
-		}
-		for_each_lt(row, min(cells.height, new_cells.height)) {
-			memcpy(&trans_memory[new_cells.width*row], &cells0[cells.width*row], min(new_cells.width, cells.width));
-		}
-		memcpy(new_cells0, trans_memory, new_cells_size);
-		memzero(new_cells1, new_cells_size);
-		cells = new_cells;
-		cells_size = new_cells_size;
-		cells0 = new_cells0;
-		cells1 = new_cells1;
-		pixels = new_pixels;
-		game_state->cells = cells;
+		//the universe stays, the viewport just shows more or less of it
+		bitmap = new_bitmap;
 		game_state->platform.bitmap = new_bitmap;
 		game_state->platform.screen = screen;
-		ret->bitmap = pixels;
-		ret->bitmap_pitch = 4*cells.width;
-		do_render_update = true;
+		game_state->is_redraw_needed = 1;
 	}
 	if(input.mouse_move_plus_one.x > 0) {
 		Vector new_mouse = {input.mouse_move_plus_one.x - 1, input.mouse_move_plus_one.y - 1};
+		if(game_state->user.is_panning) {
+			Vector pixel0 = convert_coord(bitmap, game_state->platform.screen, game_state->platform.mouse);
+			Vector pixel1 = convert_coord(bitmap, game_state->platform.screen, new_mouse);
+			pan_viewport(view, pixel1.x - pixel0.x, pixel1.y - pixel0.y);
+		}
 		game_state->platform.mouse = new_mouse;
 		if(game_state->user.is_dragging == 1) {
 			Vector pre_mouse = game_state->platform.mouse;
 			Vector cell0 = game_state->user.last_cell_in_drag;
-			Vector cell1 = convert_coord(game_state->platform.bitmap, game_state->platform.screen, game_state->platform.mouse);
+			Vector cell1 = get_viewport_cell(view, convert_coord(bitmap, game_state->platform.screen, game_state->platform.mouse));
 			auto dx = abs(cell0.x - cell1.x);
 			auto dy = abs(cell0.y - cell1.y);
 			auto d = max(dx, dy);
 			for(uint i = 1; i < d; i += 1) {
 				auto cell = lerp(cell0, cell1, cast(float, i)/d);
-				set_cell(cells0, cells.width, cell, 1);
+				queue_sim_draw(commands, cell);
 			}
-			set_cell(cells0, cells.width, cell1, 1);
+			queue_sim_draw(commands, cell1);
 			game_state->user.last_cell_in_drag = cell1;
-			do_render_update = true;
+			has_commands = true;
 		}
 	}
+	if(input.wheel_ticks != 0) {
+		Vector pixel = convert_coord(bitmap, game_state->platform.screen, game_state->platform.mouse);
+		zoom_viewport(view, pixel, pow(VIEWPORT_ZOOM_STEP, input.wheel_ticks));
+	}
 	for_each_in_range(id, 1, BUTTONS_TOTAL) {
 		auto times_pressed = input.button_presses[id];
 		for_each_lt(i, times_pressed) {
@@ -205,77 +383,381 @@ RenderData* update_game(byte* game_memory, byte* trans_memory, GameInput input)
 			if(pre_is_down == is_down) continue;
 			game_state->platform.button_is_down[id] = is_down;
 			if(id == SPACE and is_down) {
-				game_state->run_simulation ^= 1;
+				commands->toggle_pause ^= 1;
+				has_commands = true;
 			} else if(id == M1){
 				if(is_down) {
-					Vector cell = convert_coord(game_state->platform.bitmap, game_state->platform.screen, game_state->platform.mouse);
-					set_cell(cells0, cells.width, cell, 1);
+					Vector cell = get_viewport_cell(view, convert_coord(bitmap, game_state->platform.screen, game_state->platform.mouse));
+					queue_sim_draw(commands, cell);
 					game_state->user.last_cell_in_drag = cell;
 					game_state->user.is_dragging = 1;
-					do_render_update = true;
+					has_commands = true;
 				} else {
 					game_state->user.is_dragging = 0;
 				}
+			} else if(id == M2) {
+				game_state->user.is_panning = is_down;
+			} else if(id == FASTER and is_down) {
+				commands->speed_steps += 1;
+				has_commands = true;
+			} else if(id == SLOWER and is_down) {
+				commands->speed_steps -= 1;
+				has_commands = true;
+			} else if(id == JUMP and is_down) {
+				commands->jumps_total += 1;
+				has_commands = true;
 			}
 		}
 	}
 	if(game_state->user.is_dragging == 1) {
-		set_cell(cells0, cells.width, game_state->user.last_cell_in_drag, 1);
+		queue_sim_draw(commands, game_state->user.last_cell_in_drag);
+		has_commands = true;
+	}
+	if(input.rule[0]) {
+		memcpy(commands->rule, input.rule, sizeof(commands->rule));
+		has_commands = true;
+	}
+	unlock_sim_commands(sim_thread, has_commands);
+	//without its own thread the simulation gets a slice of every frame
+	int32 sim_wait_ms = -1;
+	if(!is_sim_threaded(sim_thread)) run_sim_slice(sim_thread, &sim_wait_ms);
+
+	SimFrame* new_frame = take_frame(&sim_thread->handoff);
+	if(new_frame) game_state->frame = new_frame;
+	SimFrame* frame = game_state->frame;
+	bool is_drawn = false;
+	ret->dirty_rects_total = 0;
+	bool has_view_moved = !is_viewport_equal(*view, game_state->drawn_view);
+	if(frame and (new_frame or has_view_moved or game_state->is_redraw_needed)) {
+		if(has_view_moved or game_state->is_redraw_needed or frame->redraw_version > game_state->drawn_version) {
+			add_dirty_rect(ret, 0, 0, bitmap.width, bitmap.height);
+		} else {
+			add_changed_tiles(ret, frame->tile_versions, game_state->drawn_version, frame->cells, view, bitmap);
+		}
+		ret->tile_stats = frame->tile_stats;
+		ret->gens_stepped = frame->generation - game_state->drawn_generation;
+		game_state->drawn_version = frame->version;
+		game_state->drawn_view = *view;
+		game_state->drawn_generation = frame->generation;
+		game_state->is_redraw_needed = 0;
+		is_drawn = true;
+	}
+	//the cell under a drag shows up before the simulation thread gets to it, past the edges
+	//of the universe nothing is drawn so nothing shows up
+	if(frame and game_state->user.is_dragging == 1 and is_cell_in_universe(frame->cells, game_state->user.last_cell_in_drag)) {
+		SDL_Rect rect = get_cell_rect(view, game_state->user.last_cell_in_drag, bitmap);
+		if(rect.w > 0 and rect.h > 0) add_dirty_rect(ret, rect.x, rect.y, rect.w, rect.h);
+	}
+	if(ret->dirty_rects_total > MAX_DIRTY_RECTS) {
+		ret->dirty_rects_total = 0;
+		add_dirty_rect(ret, 0, 0, bitmap.width, bitmap.height);
+	}
+	//zoomed out the pixels are drawn from the pyramid, which only follows the frames while it is needed
+	if(ret->dirty_rects_total > 0 and view->zoom < 1) {
+		update_density_pyramid(&game_state->density, frame->cells0, frame->tile_versions, frame->version);
 	}
 
-	if(!game_state->run_simulation) {//exit here
-		if(do_render_update) {
-			render_from_cells(pixels, cells0, cells, game_state->platform.bitmap);
+	ret->is_idle = !is_drawn and !has_commands and sim_wait_ms < 0;
+	if(ret->is_idle and is_sim_threaded(sim_thread)) {
+		//the simulation thread wakes the platform up with an event when it publishes
+		SDL_AtomicSet(&sim_thread->is_reader_waiting, 1);
+		if(!is_frame_taken(&sim_thread->handoff)) ret->is_idle = false;
+	}
+	return ret;
+}
+
+//draws rect, a dirty rect or a part of one, bitmap points at the locked rect, which is
+//write only, so every pixel of it is drawn
+void render_game(byte* game_memory, const RenderData* render_data, SDL_Rect rect) {
+	GameState* game_state = claim_bytes(GameState, &game_memory, 1);
+	SimFrame* frame = game_state->frame;
+	const PixelFormat* format = &game_state->platform.pixel_format;
+	byte* pixels = render_data->bitmap;
+	uint32 pitch = render_data->bitmap_pitch;
+	const Viewport* view = &game_state->view;
+	if(view->zoom < 1) {
+		render_density(pixels, pitch, format, &game_state->density, frame->cells0, view, rect);
+	} else {
+		render_from_cells(pixels, pitch, format, frame->cells0, frame->cells, view, rect);
+	}
+	if(game_state->user.is_dragging == 1 and is_cell_in_universe(frame->cells, game_state->user.last_cell_in_drag)) {
+		Vector cell = game_state->user.last_cell_in_drag;
+		SDL_Rect cell_rect = get_cell_rect(view, cell, game_state->platform.bitmap);
+		for(int32 y = max(cell_rect.y, rect.y); y < min(cell_rect.y + cell_rect.h, rect.y + rect.h); y += 1) {
+			for(int32 x = max(cell_rect.x, rect.x); x < min(cell_rect.x + cell_rect.w, rect.x + rect.w); x += 1) {
+				//the rect is padded, only the pixels that really show the cell are drawn
+				Vector pixel = {x, y};
+				Vector pixel_cell = get_viewport_cell(view, pixel);
+				if(pixel_cell.x != cell.x or pixel_cell.y != cell.y) continue;
+				set_pixel(pixels + pitch*(y - rect.y), x - rect.x, format->bytes_per_pixel, format->alive);
+			}
 		}
-		return ret;
 	}
+}
 
-	uint32 up_row  = (cells.height - 2)*cells.width;
-	uint32 cur_row = (cells.height - 1)*cells.width;
-	for(uint32 down_row = 0; down_row < cells.width*cells.height; down_row += cells.width) {
-		uint32 up_col   = cells.width - 2;
-		uint32 cur_col  = cells.width - 1;
-		for_each_lt(down_col, cells.width) {
-			uint8 total_adj_cell = 0;
-			total_adj_cell += cells0[up_row   + up_col];
-			total_adj_cell += cells0[up_row   + cur_col];
-			total_adj_cell += cells0[up_row   + down_col];
-			total_adj_cell += cells0[cur_row  + up_col];
-			total_adj_cell += cells0[cur_row  + down_col];
-			total_adj_cell += cells0[down_row + up_col];
-			total_adj_cell += cells0[down_row + cur_col];
-			total_adj_cell += cells0[down_row + down_col];
-			bool new_state = ((total_adj_cell == 3) or (cells0[cur_row + cur_col] and total_adj_cell == 2));
-			cells1[cur_row + cur_col] = new_state;
-
-			pixels[cur_row + cur_col] = new_state ? 0xFFFFFF : 0x111111;
-			up_col = cur_col;
-			cur_col = down_col;
+//SDL quietly converts formats the renderer has no texture for on every upload, which is
+//worse than drawing 32 bits in the first place, so only formats it lists count
+bool is_pixel_format_native(const SDL_RendererInfo* renderer_info, uint32 sdl_format) {
+	for_each_lt(i, renderer_info->num_texture_formats) {
+		if(renderer_info->texture_formats[i] == sdl_format) return true;
+	}
+	return false;
+}
+inline uint8 get_shade(uint32 i) {
+	return cast(uint8, 0x11 + (0xFF - 0x11)*i/255);
+}
+//fills in the shades, alive and dead of format; 0 if SDL could not make the format
+bool map_pixel_format(PixelFormat* format) {
+	SDL_PixelFormat* sdl_format = SDL_AllocFormat(format->sdl_format);
+	if(!sdl_format) return 0;
+	for(uint32 i = 0; i < 256; i += 1) {
+		uint8 shade = get_shade(i);
+		format->shades[i] = SDL_MapRGB(sdl_format, shade, shade, shade);
+	}
+	format->alive = format->shades[255];
+	format->dead = format->shades[0];
+	SDL_FreeFormat(sdl_format);
+	return 1;
+}
+//requested is a format name or auto for the narrowest the renderer supports; anything
+//the renderer can not take falls back to argb8888
+PixelFormat choose_pixel_format(const SDL_RendererInfo* renderer_info, const char* requested) {
+	bool is_auto = strcmp(requested, "auto") == 0;
+	for_each_lt(i, PIXEL_FORMATS_TOTAL) {
+		if(!is_auto and strcmp(requested, PIXEL_FORMATS[i].name) != 0) continue;
+		PixelFormat format = PIXEL_FORMATS[i];
+		if(is_pixel_format_native(renderer_info, format.sdl_format) and map_pixel_format(&format)) {
+			return format;
 		}
-		up_row = cur_row;
-		cur_row = down_row;
+		if(!is_auto) printf("renderer has no %s textures, using %s\n", requested, PIXEL_FORMATS[PIXEL_FORMAT_FALLBACK].name);
 	}
-	game_state->is_first_cells_active ^= 1;
-	if(game_state->user.is_dragging == 1) {
-		Vector cell = game_state->user.last_cell_in_drag;
-		pixels[cell.y*cells.width + cell.x] = 0xFFFFFF;
+	//SDL takes argb8888 on every renderer, converting if it has to, and it is laid out by hand
+	//if even SDL_AllocFormat fails
+	PixelFormat format = PIXEL_FORMATS[PIXEL_FORMAT_FALLBACK];
+	if(!map_pixel_format(&format)) {
+		for(uint32 i = 0; i < 256; i += 1) {
+			uint8 shade = get_shade(i);
+			format.shades[i] = (shade<<16)|(shade<<8)|shade;
+		}
+		format.alive = format.shades[255];
+		format.dead = format.shades[0];
 	}
-	return ret;
+	return format;
 }
 
+struct HeadlessConfig {
+	bool is_headless;
+	bool use_hashlife;
+	Dim cells;
+	uint64 seed;
+	float density;
+	uint64 generations;
+};
 
-float get_delta_ms(uint64 t0, uint64 t1) {
-	return (1000.0f*(t1 - t0))/SDL_GetPerformanceFrequency();
+//runs the simulation with no window as fast as it can go and reports the throughput
+int run_headless(const HeadlessConfig* headless, const GameConfig* config, WorkerPool* workers, HashLife* hashlife) {
+	Dim cells = headless->cells;
+	if(cells.width <= 3 or cells.height <= 3) {
+		printf("grid has to be bigger than 3x3\n");
+		return -1;
+	}
+	byte* memory = malloc(byte, get_simulation_memory_size(cells, config->engine));
+	if(!memory) {
+		printf("Could not allocate a %ux%u grid.\n", cells.width, cells.height);
+		return -1;
+	}
+	byte* sim_memory = memory;
+	Simulation sim;
+	init_simulation(&sim, &sim_memory, cells, config->engine, workers);
+	PCG rng;
+	pcg_seed(&rng, headless->seed);
+	randomize_simulation(&sim, &rng, headless->density);
+
+	uint64 start = SDL_GetPerformanceCounter();
+	if(headless->use_hashlife) {
+		//HashLife runs on the infinite plane, so this only agrees with the torus engines until something wraps
+		Vector origin = {-cast(int32, cells.width/2), -cast(int32, cells.height/2)};
+		load_hashlife_cells(hashlife, sim.cells0, cells, origin);
+		//largest step first, each smaller one after it keeps the results of the levels it shares
+		for(int32 k = HASHLIFE_MAX_STEP_LOG2; k >= 0; k -= 1) {
+			if((headless->generations>>k)&1) step_hashlife(hashlife, k);
+		}
+		read_hashlife_cells(hashlife, sim.cells0, cells, origin);
+		mark_simulation_edited(&sim);
+		sim.generation = hashlife->generation;
+	} else {
+		for(uint64 i = 0; i < headless->generations;) {
+			i += step_simulation_gens(&sim, cast(uint32, min(headless->generations - i, cast(uint64, TEMPORAL_GENS))));
+		}
+	}
+	uint64 end = SDL_GetPerformanceCounter();
+
+	double seconds = cast(double, end - start)/SDL_GetPerformanceFrequency();
+	double gens_per_sec = headless->generations/seconds;
+	printf("engine %s, %u threads, %ux%u cells, seed %llu, density %.3f\n", headless->use_hashlife ? "hashlife" : ENGINE_NAMES[config->engine], workers->threads_total, cells.width, cells.height, cast(unsigned long long, headless->seed), headless->density);
+	printf("%llu generations in %.3f s\n", cast(unsigned long long, sim.generation), seconds);
+	printf("%.1f gens/sec, %.4g cells/sec\n", gens_per_sec, gens_per_sec*cells.width*cells.height);
+	printf("population %llu, hash %016llx\n", cast(unsigned long long, get_simulation_population(&sim)), cast(unsigned long long, hash_simulation_cells(&sim)));
+	free(memory);
+	return 0;
+}
+
+inline void set_rule_title(SDL_Window* window, const char* typed_rule) {
+	char title[SIM_MAX_RULE + 32];
+	snprintf(title, sizeof(title), "life - rule: %s_", typed_rule);
+	SDL_SetWindowTitle(window, title);
 }
 
 int main(int argc, char** argv) {
+	uint32 threads_total = 0;
+	uint64 hashlife_memory = 512*MEGABYTE;
+	GameConfig config = {};
+	config.engine = ENGINE_BITPACK;
+	config.jump_log2 = 10;
+	config.gens_per_sec = 60;
+	bool use_vsync = 0;
+	const char* requested_format = "auto";
+	const char* rule = "B3/S23";
+	Boundary boundary = BOUNDARY_TORUS;
+	HeadlessConfig headless = {};
+	headless.cells.width = 1024;
+	headless.cells.height = 1024;
+	headless.seed = 12;
+	headless.density = .1;
+	headless.generations = 1000;
+	for(int i = 1; i < argc; i += 1) {
+		if(strcmp(argv[i], "--headless") == 0) {
+			headless.is_headless = 1;
+		} else if(strcmp(argv[i], "--size") == 0 and i + 1 < argc) {
+			i += 1;
+			if(sscanf(argv[i], "%ux%u", &headless.cells.width, &headless.cells.height) != 2) {
+				printf("--size expects WIDTHxHEIGHT, got: %s\n", argv[i]);
+			} else {
+				config.universe = headless.cells;
+			}
+		} else if(strcmp(argv[i], "--seed") == 0 and i + 1 < argc) {
+			i += 1;
+			headless.seed = strtoull(argv[i], 0, 10);
+		} else if(strcmp(argv[i], "--density") == 0 and i + 1 < argc) {
+			i += 1;
+			headless.density = atof(argv[i]);
+		} else if(strcmp(argv[i], "--gens") == 0 and i + 1 < argc) {
+			i += 1;
+			headless.generations = strtoull(argv[i], 0, 10);
+		} else if(strcmp(argv[i], "--engine") == 0 and i + 1 < argc) {
+			i += 1;
+			if(strcmp(argv[i], "hashlife") == 0) {
+				headless.use_hashlife = 1;
+			} else if(!parse_engine(argv[i], &config.engine)) {
+				printf("unknown engine: %s\n", argv[i]);
+			}
+		} else if(strcmp(argv[i], "--rule") == 0 and i + 1 < argc) {
+			i += 1;
+			rule = argv[i];
+		} else if(strcmp(argv[i], "--boundary") == 0 and i + 1 < argc) {
+			i += 1;
+			if(!parse_boundary(argv[i], &boundary)) {
+				printf("unknown boundary: %s\n", argv[i]);
+			}
+		} else if(strcmp(argv[i], "--gens-per-sec") == 0 and i + 1 < argc) {
+			i += 1;
+			config.gens_per_sec = max(cast(float, atof(argv[i])), 0.0f);
+		} else if(strcmp(argv[i], "--vsync") == 0) {
+			use_vsync = 1;
+		} else if(strcmp(argv[i], "--pixel-format") == 0 and i + 1 < argc) {
+			i += 1;
+			if(is_pixel_format_name(argv[i])) {
+				requested_format = argv[i];
+			} else {
+				printf("unknown pixel format: %s\n", argv[i]);
+			}
+		} else if(strcmp(argv[i], "--threads") == 0 and i + 1 < argc) {
+			i += 1;
+			threads_total = atoi(argv[i]);
+		} else if(strcmp(argv[i], "--jump") == 0 and i + 1 < argc) {
+			i += 1;
+			config.jump_log2 = min(cast(uint32, atoi(argv[i])), cast(uint32, HASHLIFE_MAX_STEP_LOG2));
+		} else if(strcmp(argv[i], "--hashlife-memory") == 0 and i + 1 < argc) {
+			i += 1;
+			hashlife_memory = atoi(argv[i])*MEGABYTE;
+		} else {
+			printf("unknown argument: %s\n", argv[i]);
+		}
+	}
+
+	uint64 max_hashlife_gens = (cast(uint64, 1)<<(HASHLIFE_MAX_STEP_LOG2 + 1)) - 1;
+	if(headless.use_hashlife and headless.generations > max_hashlife_gens) {
+		printf("hashlife can step at most %llu generations, got: %llu\n", cast(unsigned long long, max_hashlife_gens), cast(unsigned long long, headless.generations));
+		return -1;
+	}
+	if(headless.use_hashlife and (parse_rule(rule) != CONWAY_RULE or boundary != BOUNDARY_TORUS)) {
+		printf("hashlife only runs B3/S23, not rule %s with a %s boundary\n", rule, BOUNDARY_NAMES[boundary]);
+		return -1;
+	}
+
+	init_simd_kernels();
+	printf("using %s step kernels\n", SIMD_LEVEL_NAMES[simd_level]);
+	if(config.engine == ENGINE_JIT) {
+		if(!set_jit_rule(rule)) {
+			printf("could not parse rule %s, rules are written like B3/S23\n", rule);
+			rule = "B3/S23";
+			set_jit_rule(rule);
+		}
+		if(rule_jit.code) {
+			printf("rule %s compiled to %u terms in %u bytes of x86-64\n", rule, rule_jit.circuit.terms_total, rule_jit.code_size);
+		} else {
+			printf("rule %s has %u terms, walked without compiling\n", rule, rule_jit.circuit.terms_total);
+		}
+		if(boundary != BOUNDARY_TORUS) printf("the jit engine only runs on a torus\n");
+		boundary = BOUNDARY_TORUS;
+	} else if(config.engine == ENGINE_HENSEL) {
+		if(!set_hensel_rule(rule)) {
+			printf("could not parse rule %s, rules are written like B2n3/S23-q\n", rule);
+			rule = "B3/S23";
+			set_hensel_rule(rule);
+		}
+		printf("rule %s compiled to %u nodes\n", rule, hensel_diagram.nodes_total - HENSEL_LEAVES);
+		if(boundary != BOUNDARY_TORUS) printf("the hensel engine only runs on a torus\n");
+		boundary = BOUNDARY_TORUS;
+	} else if(config.engine == ENGINE_RULE) {
+		if(!select_rule_kernel(rule, boundary)) {
+			printf("no kernel for rule %s, the rules there are:", rule);
+			for_each_lt(i, RULE_KERNELS_TOTAL) {
+				printf(" %s", RULE_KERNELS_TABLE[i].rule);
+			}
+			printf("\n");
+			rule = RULE_KERNELS_TABLE[0].rule;
+			select_rule_kernel(rule, boundary);
+		}
+		printf("rule %s with a %s boundary\n", rule, BOUNDARY_NAMES[boundary]);
+	} else if(parse_rule(rule) != CONWAY_RULE or boundary != BOUNDARY_TORUS) {
+		printf("the %s engine only runs B3/S23 on a torus, --rule and --boundary are for the rule, jit and hensel engines\n", ENGINE_NAMES[config.engine]);
+		rule = "B3/S23";
+		boundary = BOUNDARY_TORUS;
+	}
+	config.rule = rule;
+	config.boundary = boundary;
+	if(threads_total == 0) {
+		threads_total = SDL_GetCPUCount();
+	}
+	WorkerPool workers;
+	init_worker_pool(&workers, threads_total);
+	printf("stepping with %d threads\n", workers.threads_total);
+	HashLife hashlife;
+	init_hashlife(&hashlife, hashlife_memory);
+	if(headless.is_headless) {
+		int ret = run_headless(&headless, &config, &workers, &hashlife);
+		destroy_hashlife(&hashlife);
+		destroy_worker_pool(&workers);
+		return ret;
+	}
+
 	int succ = SDL_Init(SDL_INIT_EVERYTHING);
 	if(succ == -1) {
 		//TODO: Handle failure
 		printf("Could not initialize SDL: %s.\n", SDL_GetError());
 		return -1;
 	}
-
 	Dim screen = {1800, 1000};
 
 	SDL_Window* window = SDL_CreateWindow("life", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screen.width, screen.height, SDL_WINDOW_RESIZABLE);
@@ -284,7 +766,7 @@ int main(int argc, char** argv) {
 		SDL_Quit();
 		return -1;
 	}
-	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, 0);
+	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, use_vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
 	if(!window) {
 		//TODO: Handle null renderer
 		SDL_Quit();
@@ -296,11 +778,43 @@ int main(int argc, char** argv) {
 	SDL_RenderPresent(renderer);
 
 
+	SDL_RendererInfo renderer_info;
+	if(SDL_GetRendererInfo(renderer, &renderer_info) < 0) {
+		SDL_Log("SDL_GetRendererInfo failed: %s", SDL_GetError());
+		renderer_info.flags = 0;
+		renderer_info.num_texture_formats = 0;
+		renderer_info.max_texture_width = 0;
+		renderer_info.max_texture_height = 0;
+	}
+	if(use_vsync and !(renderer_info.flags&SDL_RENDERER_PRESENTVSYNC)) {
+		printf("renderer has no vsync, pacing with sleeps\n");
+		use_vsync = 0;
+	}
+	PixelFormat pixel_format = choose_pixel_format(&renderer_info, requested_format);
+	printf("%s texture, %u bytes per cell\n", pixel_format.name, pixel_format.bytes_per_pixel);
+
 	Dim bitmap = {screen.width/2, screen.height/2};
-	SDL_Texture* bitmap_handle = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, bitmap.width, bitmap.height);
+	uint32 max_texture_size = min(renderer_info.max_texture_width, renderer_info.max_texture_height);
+	TextureGrid textures;
+	if(!init_texture_grid(&textures, renderer, pixel_format.sdl_format, bitmap, max_texture_size)) {
+		SDL_Quit();
+		return -1;
+	}
 
-	uint64 game_memory_size = 64*MEGABYTE;
+	//without a size the universe starts out as big as the window, but does not follow it
+	if(config.universe.width == 0) config.universe = bitmap;
+	if(config.universe.width <= 3 or config.universe.height <= 3) {
+		printf("universe has to be bigger than 3x3\n");
+		SDL_Quit();
+		return -1;
+	}
+	uint64 game_memory_size = sizeof(GameState) + get_sim_thread_memory_size(config.universe, config.engine) + get_density_pyramid_size(config.universe);
 	byte* game_memory = malloc(byte, game_memory_size);
+	if(!game_memory) {
+		printf("Could not allocate a %ux%u universe.\n", config.universe.width, config.universe.height);
+		SDL_Quit();
+		return -1;
+	}
 	uint64 trans_memory_size = 64*MEGABYTE;
 	byte* trans_memory = malloc(byte, trans_memory_size);
 
@@ -309,32 +823,45 @@ int main(int argc, char** argv) {
 	platform.mouse.y = 0;
 	platform.screen = screen;
 	platform.bitmap = bitmap;
+	platform.workers = &workers;
+	platform.hashlife = &hashlife;
+	platform.config = config;
+	platform.pixel_format = pixel_format;
+	platform.game_memory_size = game_memory_size;
 	initialize_game(game_memory, &platform);
 
 
-	float ms_per_frame = 1000.0f/30.0f;
-	uint32 sleep_resolution_ms = 1;
+	float refresh_ms = 1000.0f/60.0f;
 	int display_index = SDL_GetWindowDisplayIndex(window);
 	SDL_DisplayMode dm;
 	if(SDL_GetDesktopDisplayMode(display_index, &dm) < 0) {
 	    SDL_Log("SDL_GetDesktopDisplayMode failed: %s", SDL_GetError());
-	} else {
-		ms_per_frame = (1000.0f/dm.refresh_rate)*2;
+	} else if(dm.refresh_rate > 0) {
+		refresh_ms = 1000.0f/dm.refresh_rate;
 	}
+	FramePacer pacer;
+	init_frame_pacer(&pacer, refresh_ms, use_vsync);
+
+	//R starts typing a rule into the window title, enter hands it to the simulation and escape drops it
+	char typed_rule[SIM_MAX_RULE] = {};
+	uint32 typed_rule_size = 0;
+	bool is_typing_rule = 0;
+	SDL_StopTextInput();
 
-	uint64 start_of_frame = SDL_GetPerformanceCounter();
 	uint64 end_of_compute;
 	bool is_game_running = 1;
 	while(true) {
 		GameInput input = {};
 		SDL_Event event;
-		while(SDL_PollEvent(&event)) {
+		while(get_frame_event(&pacer, &event)) {
 			if(event.type == SDL_QUIT) {
 				is_game_running = 0;
 				break;
 			} else if(event.type == SDL_MOUSEMOTION) {
 				input.mouse_move_plus_one.x = event.motion.x + 1;
 				input.mouse_move_plus_one.y = event.motion.y + 1;
+			} else if(event.type == SDL_MOUSEWHEEL) {
+				input.wheel_ticks += (event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED) ? -event.wheel.y : event.wheel.y;
 			} else if(event.type == SDL_MOUSEBUTTONDOWN or event.type == SDL_MOUSEBUTTONUP) {
 				InputType button = INPUT_NULL;
 				if(event.button.button == SDL_BUTTON_LEFT) {
@@ -348,12 +875,43 @@ int main(int argc, char** argv) {
 					input.button_presses[button] += 1;
 					input.is_down[button] = (event.button.state == SDL_PRESSED);
 				}
-			} else if(event.type == SDL_KEYDOWN or event.type == SDL_KEYUP) {
+			} else if(event.type == SDL_TEXTINPUT and is_typing_rule) {
+				for(const char* c = event.text.text; *c and typed_rule_size + 1 < SIM_MAX_RULE; c += 1) {
+					typed_rule[typed_rule_size] = *c;
+					typed_rule_size += 1;
+				}
+				typed_rule[typed_rule_size] = 0;
+				set_rule_title(window, typed_rule);
+			} else if(event.type == SDL_KEYDOWN and is_typing_rule) {
+				auto scancode = event.key.keysym.scancode;
+				if(scancode == SDL_SCANCODE_BACKSPACE and typed_rule_size > 0) {
+					typed_rule_size -= 1;
+					typed_rule[typed_rule_size] = 0;
+					set_rule_title(window, typed_rule);
+				} else if(scancode == SDL_SCANCODE_RETURN or scancode == SDL_SCANCODE_KP_ENTER or scancode == SDL_SCANCODE_ESCAPE) {
+					if(scancode != SDL_SCANCODE_ESCAPE) memcpy(input.rule, typed_rule, sizeof(input.rule));
+					is_typing_rule = 0;
+					SDL_StopTextInput();
+					SDL_SetWindowTitle(window, "life");
+				}
+			} else if(event.type == SDL_KEYDOWN and event.key.keysym.scancode == SDL_SCANCODE_R and !event.key.repeat) {
+				is_typing_rule = 1;
+				typed_rule_size = 0;
+				typed_rule[0] = 0;
+				SDL_StartTextInput();
+				set_rule_title(window, typed_rule);
+			} else if((event.type == SDL_KEYDOWN or event.type == SDL_KEYUP) and !is_typing_rule) {
 				if(!event.key.repeat) {
 					auto scancode = event.key.keysym.scancode;
 					InputType button = INPUT_NULL;
 					if(scancode == SDL_SCANCODE_SPACE) {
 						button = SPACE;
+					} else if(scancode == SDL_SCANCODE_J) {
+						button = JUMP;
+					} else if(scancode == SDL_SCANCODE_UP) {
+						button = FASTER;
+					} else if(scancode == SDL_SCANCODE_DOWN) {
+						button = SLOWER;
 					}
 					if(button != INPUT_NULL) {
 						// printf("button was: %d, status: %d\n", button, (event.key.state == SDL_PRESSED));
@@ -382,10 +940,13 @@ int main(int argc, char** argv) {
 				} else if(event_id == SDL_WINDOWEVENT_RESIZED) {
 					Dim new_screen = {event.window.data1, event.window.data2};
 					assert(new_screen.width > 0 and new_screen.height > 0);
-					SDL_DestroyTexture(bitmap_handle);
+					destroy_texture_grid(&textures);
 					bitmap.width = new_screen.width/2;
 					bitmap.height = new_screen.height/2;
-					bitmap_handle = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, bitmap.width, bitmap.height);
+					if(!init_texture_grid(&textures, renderer, pixel_format.sdl_format, bitmap, max_texture_size)) {
+						is_game_running = 0;
+						break;
+					}
 					screen = new_screen;
 					input.window_resize = screen;
 					input.bitmap_resize = bitmap;
@@ -394,35 +955,57 @@ int main(int argc, char** argv) {
 		}
 		if(!is_game_running) break;
 		RenderData* render_data = update_game(game_memory, trans_memory, input);
-		SDL_UpdateTexture(bitmap_handle, 0, render_data->bitmap, render_data->bitmap_pitch);
-		SDL_RenderCopy(renderer, bitmap_handle, 0, 0);
+		//only the locked rects are uploaded, the rest of each texture keeps what it had
+		for_each_lt(i, render_data->dirty_rects_total) {
+			SDL_Rect dirty_rect = render_data->dirty_rects[i];
+			uint32 tile_x0 = dirty_rect.x/textures.tile_size;
+			uint32 tile_y0 = dirty_rect.y/textures.tile_size;
+			uint32 tile_x1 = min((dirty_rect.x + dirty_rect.w - 1)/textures.tile_size + 1, textures.tiles.width);
+			uint32 tile_y1 = min((dirty_rect.y + dirty_rect.h - 1)/textures.tile_size + 1, textures.tiles.height);
+			for(uint32 tile_y = tile_y0; tile_y < tile_y1; tile_y += 1) {
+				for(uint32 tile_x = tile_x0; tile_x < tile_x1; tile_x += 1) {
+					SDL_Rect tile_rect = get_texture_tile_rect(&textures, tile_x, tile_y);
+					SDL_Rect part;
+					if(!SDL_IntersectRect(&dirty_rect, &tile_rect, &part)) continue;
+					SDL_Rect texture_rect = {part.x - tile_rect.x, part.y - tile_rect.y, part.w, part.h};
+					SDL_Texture* texture = textures.textures[textures.tiles.width*tile_y + tile_x];
+					void* texture_pixels;
+					int texture_pitch;
+					if(SDL_LockTexture(texture, &texture_rect, &texture_pixels, &texture_pitch) < 0) {
+						SDL_Log("SDL_LockTexture failed: %s", SDL_GetError());
+						continue;
+					}
+					render_data->bitmap = cast(byte*, texture_pixels);
+					render_data->bitmap_pitch = texture_pitch;
+					render_game(game_memory, render_data, part);
+					SDL_UnlockTexture(texture);
+				}
+			}
+		}
+		copy_texture_grid(&textures, renderer, screen);
 
 		end_of_compute = SDL_GetPerformanceCounter();
-		float time_to_compute = get_delta_ms(start_of_frame, end_of_compute);
-		uint64 end_of_frame;
-		if(time_to_compute < ms_per_frame) {
-			uint32 time_to_wait = cast(uint32, ms_per_frame - time_to_compute);
-			if(time_to_wait > sleep_resolution_ms) {//TODO: decide sleep resolution
-				SDL_Delay(time_to_wait - sleep_resolution_ms);
-			}
-			end_of_frame = SDL_GetPerformanceCounter();
-			//TODO: make get_delta faster?
-			while(get_delta_ms(start_of_frame, end_of_frame) < ms_per_frame) {
-				end_of_frame = SDL_GetPerformanceCounter();
-			}
-		} else {
-			//TODO: framerate manipulation
-			printf("frame took longer than expected: %2.2f", time_to_compute);
-			end_of_frame = end_of_compute;
+		float time_to_compute = get_delta_ms(pacer.start_of_frame, end_of_compute);
+		wait_for_frame(&pacer, time_to_compute);
+		TileStats tile_stats = render_data->tile_stats;
+		unsigned long long gens_stepped = render_data->gens_stepped;
+		if(tile_stats.tiles_total > 0) {
+			printf("%2.2f, %llu gens, %d/%d tiles stepped, %d changed\n", time_to_compute, gens_stepped, tile_stats.tiles_stepped, tile_stats.tiles_total, tile_stats.tiles_flipped);
+		} else if(!render_data->is_idle) {
+			printf("%2.2f, %llu gens\n", time_to_compute, gens_stepped);
 		}
-		printf("%2.2f\n", time_to_compute);
-		start_of_frame = end_of_frame;
 		SDL_RenderPresent(renderer);
+		start_frame(&pacer);
+		pacer.is_idle = render_data->is_idle;
 
 		memzero(trans_memory, sizeof(byte)*trans_memory_size);//only for debugging, prevents transient data from being using between frames
 	}
 
 	//only program exit point
+	shutdown_game(game_memory);
+	destroy_texture_grid(&textures);
+	destroy_hashlife(&hashlife);
+	destroy_worker_pool(&workers);
 	SDL_Quit();
 	return 0;
 }
@@ -0,0 +1,130 @@
+//By Monica Moniot
+#pragma once
+//Temporal blocking for the byte grid: one pass over the grid advances it up to TEMPORAL_GENS
+//generations, so cells0 is read and cells1 written once for all of them instead of once each.
+//Every stripe is cut into bands of columns, and a band is swept down its rows as a wavefront:
+//each row of cells0 read, with the torus wrapped in, lets every generation after it step the
+//row just above its own last one, until the last generation lands in cells1. A generation
+//only ever needs the three newest rows of the one before it, so all that is kept is a ring
+//of three rows per generation, small enough to stay in L2. To stand alone a band reads gens
+//more cells on each side and its stripe gens more rows above and below, those are stepped
+//as far as they can be and thrown away.
+
+#define TEMPORAL_BAND_WIDTH 4096//wide enough that each row read is a long run the prefetcher can follow
+#define TEMPORAL_GENS 4//the most generations one pass over the grid advances
+#define TEMPORAL_ROW_STRIDE (TEMPORAL_BAND_WIDTH + 2*TEMPORAL_GENS)
+
+//copies width cells of the row from x on, wrapping around as many times as it takes
+inline void copy_wrapped_row(uint8* dest, const bool* row, uint32 cells_width, uint32 x, uint32 width) {
+	while(width > 0) {
+		uint32 run = min(width, cells_width - x);
+		memcpy(dest, row + x, run);
+		dest += run;
+		width -= run;
+		x = 0;
+	}
+}
+
+//steps columns [x0, x1) of a row with no wrap, the rows have to have a cell either side of that
+void step_band_row_scalar(const uint8* up, const uint8* cur, const uint8* down, uint8* new_row, uint32 x0, uint32 x1) {
+	for(uint32 x = x0; x < x1; x += 1) {
+		new_row[x] = step_cell_byte(up, cur, down, x - 1, x, x + 1);
+	}
+}
+#if LIFE_X86
+TARGET_SSE2 void step_band_row_sse2(const uint8* up, const uint8* cur, const uint8* down, uint8* new_row, uint32 x0, uint32 x1) {
+	if(x1 - x0 < 16) {
+		step_band_row_scalar(up, cur, down, new_row, x0, x1);
+		return;
+	}
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i three = _mm_set1_epi8(3);
+	//what is left past the last full vector is done by one more that overlaps it,
+	//writing some cells twice with the same value
+	for(uint32 x = x0; x < x1; x += 16) {
+		x = min(x, x1 - 16);
+		__m128i total = _mm_add_epi8(_mm_loadu_si128(cast(const __m128i*, up + x - 1)), _mm_loadu_si128(cast(const __m128i*, up + x)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, up + x + 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, cur + x - 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, cur + x + 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, down + x - 1)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, down + x)));
+		total = _mm_add_epi8(total, _mm_loadu_si128(cast(const __m128i*, down + x + 1)));
+		__m128i alive = _mm_cmpeq_epi8(_mm_or_si128(total, _mm_loadu_si128(cast(const __m128i*, cur + x))), three);
+		_mm_storeu_si128(cast(__m128i*, new_row + x), _mm_and_si128(alive, one));
+	}
+}
+#endif
+inline void step_band_row(const uint8* up, const uint8* cur, const uint8* down, uint8* new_row, uint32 x0, uint32 x1) {
+#if LIFE_X86
+	if(simd_level >= SIMD_SSE2) {
+		step_band_row_sse2(up, cur, down, new_row, x0, x1);
+		return;
+	}
+#endif
+	step_band_row_scalar(up, cur, down, new_row, x0, x1);
+}
+
+//advances rows [y0, y1) of the band starting at column x0 gens generations, from cells0 to cells1
+void step_temporal_band(const bool* cells0, bool* cells1, Dim cells, uint32 x0, uint32 y0, uint32 y1, uint32 gens) {
+	//rings[g][r%3] is row r of generation g, counting rows from the first one read
+	uint8 rings[TEMPORAL_GENS][3][TEMPORAL_ROW_STRIDE];
+	const uint8* rows0[3];
+	uint8 last_row[TEMPORAL_ROW_STRIDE];
+	uint32 w = min(cast(uint32, TEMPORAL_BAND_WIDTH), cells.width - x0);
+	uint32 band_w = w + 2*gens;
+	//gens is at most 4 and the grid is bigger than 3x3, so neither start can go negative
+	uint32 band_x = (x0 + cells.width - gens)%cells.width;
+	uint32 first_y = (y0 + cells.height - gens)%cells.height;
+	uint32 rows_total = (y1 - y0) + 2*gens;
+	//a band that does not wrap around can read generation 0 from cells0 and write the last one
+	//into cells1 where they are, only the bands on the edges have to copy rows
+	bool is_inside = band_x + band_w <= cells.width;
+	for_each_lt(r, rows_total) {
+		const bool* cells_row = &cells0[cast(uint64, cells.width)*((first_y + r)%cells.height)];
+		if(is_inside) {
+			rows0[r%3] = cast(const uint8*, cells_row + band_x);
+		} else {
+			copy_wrapped_row(rings[0][r%3], cells_row, cells.width, band_x, band_w);
+			rows0[r%3] = rings[0][r%3];
+		}
+		//row r of generation 0 is in, generation g can step its row r - g once it has a row
+		//above that too; each generation starts a row further down and a cell further in
+		for(uint32 g = 1; g <= gens and r >= 2*g; g += 1) {
+			uint32 row = r - g;
+			const uint8* up = (g == 1) ? rows0[(row - 1)%3] : rings[g - 1][(row - 1)%3];
+			const uint8* cur = (g == 1) ? rows0[row%3] : rings[g - 1][row%3];
+			const uint8* down = (g == 1) ? rows0[(row + 1)%3] : rings[g - 1][(row + 1)%3];
+			if(g < gens) {
+				step_band_row(up, cur, down, rings[g][row%3], g, band_w - g);
+				continue;
+			}
+			bool* new_row = &cells1[cast(uint64, cells.width)*(y0 + row - gens)];
+			if(is_inside) {
+				step_band_row(up, cur, down, cast(uint8*, new_row + band_x), g, band_w - g);
+			} else {
+				step_band_row(up, cur, down, last_row, g, band_w - g);
+				memcpy(new_row + x0, last_row + gens, w);
+			}
+		}
+	}
+}
+
+struct StepTemporalJob {
+	const bool* cells0;
+	bool* cells1;
+	Dim cells;
+	uint32 gens;
+};
+void step_temporal_stripe(void* data, uint32 row_begin, uint32 row_end) {
+	StepTemporalJob* job = cast(StepTemporalJob*, data);
+	for(uint32 x0 = 0; x0 < job->cells.width; x0 += TEMPORAL_BAND_WIDTH) {
+		step_temporal_band(job->cells0, job->cells1, job->cells, x0, row_begin, row_end, job->gens);
+	}
+}
+//gens has to be from 1 to TEMPORAL_GENS
+void step_cells_temporal(WorkerPool* pool, const bool* cells0, bool* cells1, Dim cells, uint32 gens) {
+	assert(gens >= 1 and gens <= TEMPORAL_GENS);
+	StepTemporalJob job = {cells0, cells1, cells, gens};
+	run_stripes(pool, step_temporal_stripe, &job, cells.height);
+}
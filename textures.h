@@ -0,0 +1,72 @@
+//By Monica Moniot
+#pragma once
+//The bitmap is shown through a grid of streaming textures instead of one, so how big it can
+//get is not limited by the biggest texture the renderer can make, and a dirty rect only
+//locks and uploads the textures it touches. SDL_RenderCopy stitches them back together.
+
+#define TEXTURE_TILE_SIZE 512
+
+struct TextureGrid {
+	Dim bitmap;
+	uint32 tile_size;
+	Dim tiles;
+	SDL_Texture** textures;
+};
+
+void destroy_texture_grid(TextureGrid* grid) {
+	for_each_lt(i, grid->tiles.width*grid->tiles.height) {
+		if(grid->textures[i]) SDL_DestroyTexture(grid->textures[i]);
+	}
+	free(grid->textures);
+	memzero(grid, sizeof(TextureGrid));
+}
+//max_texture_size is 0 when the renderer does not say; on failure every texture made so far
+//is destroyed again and the grid is left empty
+bool init_texture_grid(TextureGrid* grid, SDL_Renderer* renderer, uint32 sdl_format, Dim bitmap, uint32 max_texture_size) {
+	memzero(grid, sizeof(TextureGrid));
+	grid->bitmap = bitmap;
+	grid->tile_size = (max_texture_size > 0) ? min(cast(uint32, TEXTURE_TILE_SIZE), max_texture_size) : TEXTURE_TILE_SIZE;
+	grid->tiles.width = divceil(bitmap.width, grid->tile_size);
+	grid->tiles.height = divceil(bitmap.height, grid->tile_size);
+	uint32 tiles_size = grid->tiles.width*grid->tiles.height;
+	grid->textures = malloc(SDL_Texture*, tiles_size);
+	memzero(grid->textures, sizeof(SDL_Texture*)*tiles_size);
+	for_each_lt(tile_y, grid->tiles.height) {
+		for(uint32 tile_x = 0; tile_x < grid->tiles.width; tile_x += 1) {
+			uint32 width = min(grid->tile_size, bitmap.width - tile_x*grid->tile_size);
+			uint32 height = min(grid->tile_size, bitmap.height - tile_y*grid->tile_size);
+			SDL_Texture* texture = SDL_CreateTexture(renderer, sdl_format, SDL_TEXTUREACCESS_STREAMING, width, height);
+			if(!texture) {
+				SDL_Log("SDL_CreateTexture failed: %s", SDL_GetError());
+				destroy_texture_grid(grid);
+				return false;
+			}
+			grid->textures[grid->tiles.width*tile_y + tile_x] = texture;
+		}
+	}
+	return true;
+}
+
+//the part of the bitmap the texture tile holds
+inline SDL_Rect get_texture_tile_rect(const TextureGrid* grid, uint32 tile_x, uint32 tile_y) {
+	uint32 x = tile_x*grid->tile_size;
+	uint32 y = tile_y*grid->tile_size;
+	SDL_Rect rect = {cast(int, x), cast(int, y), cast(int, min(grid->tile_size, grid->bitmap.width - x)), cast(int, min(grid->tile_size, grid->bitmap.height - y))};
+	return rect;
+}
+
+//scales the bitmap up to the screen, the edges of each tile are rounded the same way on
+//both of its sides so no seams open between them
+void copy_texture_grid(const TextureGrid* grid, SDL_Renderer* renderer, Dim screen) {
+	for_each_lt(tile_y, grid->tiles.height) {
+		for(uint32 tile_x = 0; tile_x < grid->tiles.width; tile_x += 1) {
+			SDL_Rect rect = get_texture_tile_rect(grid, tile_x, tile_y);
+			int x0 = cast(int, cast(uint64, rect.x)*screen.width/grid->bitmap.width);
+			int y0 = cast(int, cast(uint64, rect.y)*screen.height/grid->bitmap.height);
+			int x1 = cast(int, cast(uint64, rect.x + rect.w)*screen.width/grid->bitmap.width);
+			int y1 = cast(int, cast(uint64, rect.y + rect.h)*screen.height/grid->bitmap.height);
+			SDL_Rect dest = {x0, y0, x1 - x0, y1 - y0};
+			SDL_RenderCopy(renderer, grid->textures[grid->tiles.width*tile_y + tile_x], 0, &dest);
+		}
+	}
+}
@@ -0,0 +1,124 @@
+//By Monica Moniot
+#pragma once
+//Active-tile stepping for the byte grid. The grid is cut into TILE_SIZE x TILE_SIZE tiles and
+//every generation records which tiles changed. A tile is only stepped when it or one of its
+//eight neighbours (wrapping like the cells) changed. Changed here means different from two
+//generations ago, which is what the buffer being written into still holds: if the whole
+//neighbourhood repeats generation t - 2, the tile's next generation is t - 1, and that is
+//already sitting in the buffer. So still lifes and blinkers are both skipped for free.
+//The tile flags have to flip together with cells0/cells1. Anything that writes cells behind
+//their back has to mark the tiles it touched as edited, which keeps them changed for one
+//more generation, since their old buffer no longer holds a real predecessor.
+
+#define TILE_SIZE 32
+#define TILE_CHANGED 1//differs from two generations ago
+#define TILE_FLIPPED 2//differs from what was last drawn, so its pixels need redrawing
+#define TILE_EDITED 4
+#define TILE_STEPPED 8
+
+struct TileStats {
+	uint32 tiles_total;
+	uint32 tiles_stepped;
+	uint32 tiles_flipped;
+};
+
+inline Dim get_tiles_dim(Dim cells) {
+	Dim tiles = {divceil(cells.width, TILE_SIZE), divceil(cells.height, TILE_SIZE)};
+	return tiles;
+}
+inline uint32 get_tiles_size(Dim cells) {
+	Dim tiles = get_tiles_dim(cells);
+	return tiles.width*tiles.height;
+}
+inline void mark_tile_changed(uint8* tiles, Dim cells, Vector cell) {
+	Dim tiles_dim = get_tiles_dim(cells);
+	tiles[tiles_dim.width*(cell.y/TILE_SIZE) + cell.x/TILE_SIZE] |= TILE_CHANGED|TILE_EDITED;
+}
+inline void mark_all_tiles_changed(uint8* tiles, Dim cells) {
+	memset(tiles, TILE_CHANGED|TILE_EDITED, get_tiles_size(cells));
+}
+
+inline bool is_tile_active(const uint8* tiles, Dim tiles_dim, uint32 tile_x, uint32 tile_y) {
+	uint32 west = (tile_x == 0) ? tiles_dim.width - 1 : tile_x - 1;
+	uint32 east = (tile_x + 1 == tiles_dim.width) ? 0 : tile_x + 1;
+	uint32 north = (tile_y == 0) ? tiles_dim.height - 1 : tile_y - 1;
+	uint32 south = (tile_y + 1 == tiles_dim.height) ? 0 : tile_y + 1;
+	uint32 rows[3] = {north, tile_y, south};
+	uint8 changed = 0;
+	for_each_lt(i, 3) {
+		const uint8* row = &tiles[tiles_dim.width*rows[i]];
+		changed |= row[west]|row[tile_x]|row[east];
+	}
+	return changed&TILE_CHANGED;
+}
+
+inline void step_tile_cell(CellRows r, uint32 west, uint32 x, uint32 east, uint8* changed, uint8* flipped) {
+	bool new_state = step_cell_byte(r.up, r.cur, r.down, west, x, east);
+	*changed |= new_state^r.new_row[x];
+	*flipped |= new_state^r.cur[x];
+	r.new_row[x] = new_state;
+}
+//steps one tile, returns its TILE_CHANGED and TILE_FLIPPED flags
+uint8 step_cells_tile(const bool* cells0, bool* cells1, Dim cells, uint32 tile_x, uint32 tile_y) {
+	uint32 x0 = tile_x*TILE_SIZE;
+	uint32 x1 = min(x0 + TILE_SIZE, cells.width);
+	uint32 y0 = tile_y*TILE_SIZE;
+	uint32 y1 = min(y0 + TILE_SIZE, cells.height);
+	//the wrapping columns are done on their own so the inner loop has no branches
+	uint32 inner_x0 = max(x0, 1u);
+	uint32 inner_x1 = min(x1, cells.width - 1);
+	uint8 changed = 0;
+	uint8 flipped = 0;
+	for(uint32 y = y0; y < y1; y += 1) {
+		CellRows r = get_cell_rows(cells0, cells1, cells, y);
+		if(x0 == 0) {
+			step_tile_cell(r, cells.width - 1, 0, 1, &changed, &flipped);
+		}
+		for(uint32 x = inner_x0; x < inner_x1; x += 1) {
+			step_tile_cell(r, x - 1, x, x + 1, &changed, &flipped);
+		}
+		if(x1 == cells.width) {
+			step_tile_cell(r, cells.width - 2, cells.width - 1, 0, &changed, &flipped);
+		}
+	}
+	return (changed ? TILE_CHANGED : 0)|(flipped ? TILE_FLIPPED : 0);
+}
+struct StepTilesJob {
+	const bool* cells0;
+	bool* cells1;
+	const uint8* tiles0;
+	uint8* tiles1;
+	Dim cells;
+};
+void step_tiles_stripe(void* data, uint32 tile_row_begin, uint32 tile_row_end) {
+	StepTilesJob* job = cast(StepTilesJob*, data);
+	Dim tiles_dim = get_tiles_dim(job->cells);
+	for(uint32 tile_y = tile_row_begin; tile_y < tile_row_end; tile_y += 1) {
+		for_each_lt(tile_x, tiles_dim.width) {
+			uint8 pre_flags = job->tiles0[tiles_dim.width*tile_y + tile_x];
+			uint8 flags = 0;
+			if(is_tile_active(job->tiles0, tiles_dim, tile_x, tile_y)) {
+				flags = TILE_STEPPED|step_cells_tile(job->cells0, job->cells1, job->cells, tile_x, tile_y);
+				//what is on screen for an edited tile is from before the edit
+				if(pre_flags&TILE_EDITED) flags |= TILE_CHANGED|TILE_FLIPPED;
+			} else if(pre_flags&TILE_FLIPPED) {
+				//a skipped tile that was flipping is back to the generation before it
+				flags = TILE_FLIPPED;
+			}
+			job->tiles1[tiles_dim.width*tile_y + tile_x] = flags;
+		}
+	}
+}
+TileStats step_cells_tiled(WorkerPool* pool, const bool* cells0, bool* cells1, const uint8* tiles0, uint8* tiles1, Dim cells) {
+	StepTilesJob job = {cells0, cells1, tiles0, tiles1, cells};
+	Dim tiles_dim = get_tiles_dim(cells);
+	run_stripes(pool, step_tiles_stripe, &job, tiles_dim.height);
+
+	TileStats stats = {};
+	stats.tiles_total = tiles_dim.width*tiles_dim.height;
+	for_each_lt(i, stats.tiles_total) {
+		stats.tiles_stepped += (tiles1[i]&TILE_STEPPED) != 0;
+		stats.tiles_flipped += (tiles1[i]&TILE_FLIPPED) != 0;
+	}
+	return stats;
+}
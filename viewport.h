@@ -0,0 +1,56 @@
+//By Monica Moniot
+#pragma once
+//Which part of the universe the bitmap shows. The universe does not follow the window,
+//the viewport does: x and y are the universe position of the bitmap's top left corner and
+//zoom is how many bitmap pixels one cell takes, below 1 when zoomed out. Pixel p shows the
+//cell under its centre, floor(x + (p + .5)/zoom).
+
+#define VIEWPORT_MIN_ZOOM (1.0/1024)
+#define VIEWPORT_MAX_ZOOM 64.0
+#define VIEWPORT_ZOOM_STEP 1.25//per tick of the mouse wheel
+
+struct Viewport {
+	double x;
+	double y;
+	double zoom;
+};
+
+inline bool is_viewport_equal(Viewport v0, Viewport v1) {
+	return v0.x == v1.x and v0.y == v1.y and v0.zoom == v1.zoom;
+}
+
+//centres the universe in the bitmap, zoomed so that it fits but never past 1 pixel per cell
+void center_viewport(Viewport* view, Dim universe, Dim bitmap) {
+	view->zoom = min(min(cast(double, bitmap.width)/universe.width, cast(double, bitmap.height)/universe.height), 1.0);
+	view->zoom = max(view->zoom, VIEWPORT_MIN_ZOOM);
+	view->x = (universe.width - bitmap.width/view->zoom)/2;
+	view->y = (universe.height - bitmap.height/view->zoom)/2;
+}
+
+inline Vector get_viewport_cell(const Viewport* view, Vector pixel) {
+	Vector cell = {cast(int32, floor(view->x + (pixel.x + .5)/view->zoom)), cast(int32, floor(view->y + (pixel.y + .5)/view->zoom))};
+	return cell;
+}
+
+//the pixels in [*p0, *p1) that can show cells in [c0, c1) along one axis, padded by a pixel
+//against rounding and clipped to [0, pixels)
+inline void get_viewport_span(double view_start, double zoom, double c0, double c1, uint32 pixels, int32* p0, int32* p1) {
+	double start = floor((c0 - view_start)*zoom) - 1;
+	double end = ceil((c1 - view_start)*zoom) + 1;
+	*p0 = cast(int32, min(max(start, 0.0), cast(double, pixels)));
+	*p1 = cast(int32, min(max(end, 0.0), cast(double, pixels)));
+}
+
+//keeps the cell under pixel where it is
+void zoom_viewport(Viewport* view, Vector pixel, double factor) {
+	double zoom = min(max(view->zoom*factor, VIEWPORT_MIN_ZOOM), VIEWPORT_MAX_ZOOM);
+	double px = pixel.x + .5;
+	double py = pixel.y + .5;
+	view->x += px/view->zoom - px/zoom;
+	view->y += py/view->zoom - py/zoom;
+	view->zoom = zoom;
+}
+inline void pan_viewport(Viewport* view, int32 pixels_x, int32 pixels_y) {
+	view->x -= pixels_x/view->zoom;
+	view->y -= pixels_y/view->zoom;
+}
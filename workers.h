@@ -0,0 +1,129 @@
+//By Monica Moniot
+#pragma once
+//Persistent pool of worker threads that split a generation into horizontal stripes.
+//Workers are spawned once and sleep on their own semaphore between generations;
+//the calling thread steps the first stripe itself, so threads_total includes it.
+//Every row only reads the previous generation, so the result does not depend on the split.
+
+typedef void (*StripeFn)(void* job, uint32 row_begin, uint32 row_end);
+
+struct WorkerPool;
+struct Worker {
+	WorkerPool* pool;
+	uint32 index;
+	SDL_Thread* thread;
+	SDL_sem* start;
+};
+struct WorkerPool {
+	uint32 threads_total;
+	Worker* workers;
+	SDL_sem* done;
+	SDL_atomic_t is_quitting;
+	StripeFn stripe_fn;
+	void* job;
+	uint32 rows_total;
+};
+
+inline uint32 get_stripe_begin(uint32 rows_total, uint32 stripes_total, uint32 i) {
+	return cast(uint32, (cast(uint64, rows_total)*i)/stripes_total);
+}
+inline void run_stripe(WorkerPool* pool, uint32 i) {
+	uint32 row_begin = get_stripe_begin(pool->rows_total, pool->threads_total, i);
+	uint32 row_end = get_stripe_begin(pool->rows_total, pool->threads_total, i + 1);
+	if(row_begin < row_end) pool->stripe_fn(pool->job, row_begin, row_end);
+}
+
+int worker_main(void* data) {
+	Worker* worker = cast(Worker*, data);
+	WorkerPool* pool = worker->pool;
+	while(true) {
+		SDL_SemWait(worker->start);
+		if(SDL_AtomicGet(&pool->is_quitting)) break;
+		run_stripe(pool, worker->index);
+		SDL_SemPost(pool->done);
+	}
+	return 0;
+}
+
+void init_worker_pool(WorkerPool* pool, uint32 threads_total) {
+	memzero(pool, sizeof(WorkerPool));
+	pool->threads_total = max(threads_total, 1u);
+	pool->done = SDL_CreateSemaphore(0);
+	uint32 workers_total = pool->threads_total - 1;
+	pool->workers = malloc(Worker, workers_total + 1);
+	for_each_lt(i, workers_total) {
+		Worker* worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i + 1;
+		worker->start = SDL_CreateSemaphore(0);
+		worker->thread = SDL_CreateThread(worker_main, "life worker", worker);
+		if(!worker->thread) {
+			//the stripes are split between the threads that did start, the rest are never posted to
+			printf("Could not create worker thread: %s, stepping with %u threads.\n", SDL_GetError(), i + 1);
+			SDL_DestroySemaphore(worker->start);
+			pool->threads_total = i + 1;
+			break;
+		}
+	}
+}
+void destroy_worker_pool(WorkerPool* pool) {
+	SDL_AtomicSet(&pool->is_quitting, 1);
+	for_each_lt(i, pool->threads_total - 1) {
+		Worker* worker = &pool->workers[i];
+		SDL_SemPost(worker->start);
+		SDL_WaitThread(worker->thread, 0);
+		SDL_DestroySemaphore(worker->start);
+	}
+	SDL_DestroySemaphore(pool->done);
+	free(pool->workers);
+	memzero(pool, sizeof(WorkerPool));
+}
+
+//blocks until every stripe of [0, rows_total) has been run through stripe_fn
+void run_stripes(WorkerPool* pool, StripeFn stripe_fn, void* job, uint32 rows_total) {
+	if(!pool or pool->threads_total <= 1) {
+		stripe_fn(job, 0, rows_total);
+		return;
+	}
+	pool->stripe_fn = stripe_fn;
+	pool->job = job;
+	pool->rows_total = rows_total;
+	uint32 workers_total = pool->threads_total - 1;
+	for_each_lt(i, workers_total) {
+		SDL_SemPost(pool->workers[i].start);
+	}
+	run_stripe(pool, 0);
+	for(uint32 i = 0; i < workers_total; i += 1) {
+		SDL_SemWait(pool->done);
+	}
+}
+
+
+struct StepCellsJob {
+	StepRowsFn step_rows;
+	const bool* cells0;
+	bool* cells1;
+	Dim cells;
+};
+void step_cells_stripe(void* data, uint32 row_begin, uint32 row_end) {
+	StepCellsJob* job = cast(StepCellsJob*, data);
+	job->step_rows(job->cells0, job->cells1, job->cells, row_begin, row_end);
+}
+void step_cells_striped(WorkerPool* pool, StepRowsFn step_rows, const bool* cells0, bool* cells1, Dim cells) {
+	StepCellsJob job = {step_rows, cells0, cells1, cells};
+	run_stripes(pool, step_cells_stripe, &job, cells.height);
+}
+
+struct StepBitsJob {
+	const uint64* bits0;
+	uint64* bits1;
+	Dim cells;
+};
+void step_bits_stripe(void* data, uint32 row_begin, uint32 row_end) {
+	StepBitsJob* job = cast(StepBitsJob*, data);
+	step_bits_rows(job->bits0, job->bits1, job->cells, row_begin, row_end);
+}
+void step_bits_striped(WorkerPool* pool, const uint64* bits0, uint64* bits1, Dim cells) {
+	StepBitsJob job = {bits0, bits1, cells};
+	run_stripes(pool, step_bits_stripe, &job, cells.height);
+}